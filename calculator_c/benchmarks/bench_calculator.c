@@ -0,0 +1,163 @@
+#include "calculator.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+
+/**
+ * Сравнение способов вычисления выражения: полный разбор при каждом вызове
+ * (calc_evaluate), рекурсивный обход AST (evaluator_evaluate), выполнение
+ * скомпилированной программы стековой машины (calc_eval_compiled) и пакетное
+ * вычисление по столбцу значений (calc_eval_batch).
+ * Запуск: bench_calculator [количество_вычислений]
+ */
+
+// Выражения для замера
+static const char* const EXPRESSIONS[] = {
+    "x + 1",
+    "2 * x ^ 2 - 3 * x + 5",
+    "sin(x) * cos(x) + x / (1 + x * x)",
+    "((x + 1) * (x + 2) * (x + 3)) / ((x + 4) * (x + 5)) - PI * x",
+    "x * (PI / 180) + 2 ^ 10 * sin(PI / 4) * 1",
+};
+
+/**
+ * Разбирает выражение в AST для вычисления обходом дерева.
+ *
+ * @param expression Строка с выражением
+ * @param arena Арена, в которой размещается AST
+ * @param functions Таблица функций для разрешения вызовов
+ * @return Корневой узел AST или NULL при ошибке разбора
+ */
+static ast_node_t* parse(const char* expression, arena_t* arena, const function_table_t* functions) {
+    lexer_t* lexer = lexer_create(expression, arena);
+    parser_t* parser = lexer ? parser_create(lexer, arena, functions) : NULL;
+    return parser ? parser_parse(parser) : NULL;
+}
+
+/**
+ * Возвращает время в секундах с момента start.
+ *
+ * @param start Момент начала замера
+ * @return Затраченное процессорное время в секундах
+ */
+static double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+    if (iterations <= 0) {
+        fprintf(stderr, "Использование: %s [количество_вычислений]\n", argv[0]);
+        return 1;
+    }
+    
+    // Обход AST использует те же встроенные функции, что и контекст калькулятора
+    function_table_t functions;
+    if (!function_table_init(&functions)) {
+        fprintf(stderr, "Не удалось создать таблицу функций\n");
+        return 1;
+    }
+    
+    calculator_ctx_t* calc = calc_create();
+    evaluator_t* eval = calc ? evaluator_create(calc) : NULL;
+    if (!eval) {
+        fprintf(stderr, "Не удалось создать контекст калькулятора\n");
+        calc_destroy(calc);
+        function_table_free(&functions);
+        return 1;
+    }
+    
+    // Столбец значений переменной для пакетного вычисления
+    double* xs = malloc(iterations * sizeof(double));
+    double* results = malloc(iterations * sizeof(double));
+    if (!xs || !results) {
+        fprintf(stderr, "Не удалось выделить память для пакета\n");
+        free(xs);
+        free(results);
+        evaluator_destroy(eval);
+        calc_destroy(calc);
+        function_table_free(&functions);
+        return 1;
+    }
+    for (long i = 0; i < iterations; i++) {
+        xs[i] = i * 0.001;
+    }
+    const calc_column_t column = {"x", xs};
+    
+    // Значение x в циклах поштучного вычисления задается по слоту, без поиска по имени
+    size_t x_slot;
+    calc_resolve_variable(calc, "x", &x_slot);
+    
+    printf("Вычислений на выражение: %ld, время одного вычисления в нс\n", iterations);
+    printf("%-64s %10s %10s %10s %10s %8s\n", "expression", "parse", "ast", "vm", "batch", "ast/vm");
+    
+    int status = 0;
+    for (size_t e = 0; e < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); e++) {
+        const char* expression = EXPRESSIONS[e];
+        arena_t* arena = arena_create(1024);
+        ast_node_t* ast = arena ? parse(expression, arena, &functions) : NULL;
+        calc_expression_t* compiled = NULL;
+        if (!ast || calc_compile(calc, expression, &compiled) != CALC_SUCCESS) {
+            fprintf(stderr, "Не удалось разобрать выражение: %s\n", expression);
+            arena_destroy(arena);
+            status = 1;
+            break;
+        }
+        
+        // Полный разбор выполняется на порядок дольше, поэтому замеряется на меньшем числе вычислений
+        long parse_iterations = iterations / 10 + 1;
+        double parse_sum = 0, tree_sum = 0, vm_sum = 0, batch_sum = 0, value;
+        
+        clock_t start = clock();
+        for (long i = 0; i < parse_iterations; i++) {
+            calc_set_variable(calc, "x", i * 0.001);
+            if (calc_evaluate(calc, expression, &value) == CALC_SUCCESS) parse_sum += value;
+        }
+        double parse_time = seconds_since(start) / parse_iterations;
+        
+        start = clock();
+        for (long i = 0; i < iterations; i++) {
+            calc_set_variable_by_slot(calc, x_slot, i * 0.001);
+            if (evaluator_evaluate(eval, ast, &value) == CALC_SUCCESS) tree_sum += value;
+        }
+        double tree_time = seconds_since(start) / iterations;
+        
+        start = clock();
+        for (long i = 0; i < iterations; i++) {
+            calc_set_variable_by_slot(calc, x_slot, i * 0.001);
+            if (calc_eval_compiled(calc, compiled, &value) == CALC_SUCCESS) vm_sum += value;
+        }
+        double vm_time = seconds_since(start) / iterations;
+        
+        start = clock();
+        calc_eval_batch(calc, compiled, &column, 1, iterations, results, NULL);
+        double batch_time = seconds_since(start) / iterations;
+        for (long i = 0; i < iterations; i++) {
+            if (!isnan(results[i])) batch_sum += results[i];
+        }
+        
+        printf("%-64s %10.1f %10.1f %10.1f %10.1f %8.2f\n", expression, parse_time * 1e9, tree_time * 1e9,
+               vm_time * 1e9, batch_time * 1e9, vm_time > 0 ? tree_time / vm_time : 0.0);
+        
+        // Все вычислители должны получить одинаковые значения
+        if (tree_sum != vm_sum || vm_sum != batch_sum) {
+            fprintf(stderr, "Результаты расходятся: %.17g, %.17g и %.17g (разбор: %.17g)\n",
+                    tree_sum, vm_sum, batch_sum, parse_sum);
+            status = 1;
+        }
+        
+        calc_free_compiled(compiled);
+        arena_destroy(arena);
+    }
+    
+    free(results);
+    free(xs);
+    evaluator_destroy(eval);
+    calc_destroy(calc);
+    function_table_free(&functions);
+    return status;
+}
@@ -0,0 +1,44 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * Арена (регион) памяти: выделение сдвигом указателя внутри крупных блоков
+ * и освобождение всей памяти одним вызовом. В ней размещаются лексический
+ * и синтаксический анализаторы, узлы AST и строки одного разбора
+ * Используем неполный тип для скрытия реализации (паттерн "Непрозрачный указатель")
+ */
+typedef struct arena_t arena_t;
+
+/**
+ * Создает арену; первый блок выделяется вместе с самой ареной
+ * @param initial_size Размер первого блока в байтах
+ * @return Указатель на созданную арену или NULL при ошибке
+ */
+arena_t* arena_create(size_t initial_size);
+
+/**
+ * Освобождает арену и всю выделенную в ней память
+ * @param arena Указатель на арену
+ */
+void arena_destroy(arena_t* arena);
+
+/**
+ * Выделяет память в арене. Память выровнена для любого типа и живет до уничтожения арены
+ * @param arena Указатель на арену
+ * @param size Размер в байтах
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Копирует строку в арену
+ * @param arena Указатель на арену
+ * @param str Исходная строка
+ * @param length Количество копируемых символов
+ * @return Указатель на копию, завершенную нулевым символом, или NULL при ошибке
+ */
+char* arena_strndup(arena_t* arena, const char* str, size_t length);
+
+#endif // ARENA_H
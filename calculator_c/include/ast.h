@@ -1,20 +1,26 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stddef.h>
+#include "arena.h"
+#include "function_table.h"
+
 /**
  * Перечисление типов узлов абстрактного синтаксического дерева
  */
 typedef enum {
     AST_NUMBER,    // Числовая константа
     AST_VARIABLE,  // Переменная
-    AST_UNARY_OP,  // Унарная операция (например, sin, cos, факториал)
-    AST_BINARY_OP  // Бинарная операция (+, -, *, /, ^)
+    AST_UNARY_OP,  // Унарная операция (унарный минус, факториал)
+    AST_BINARY_OP, // Бинарная операция (+, -, *, /, ^)
+    AST_CALL       // Вызов функции (например, sin(x), mod(x, 3))
 } ast_node_type_t;
 
 /**
  * Структура узла абстрактного синтаксического дерева (AST)
- * Представляет собой универсальный узел, который может быть одним
- * из четырех типов: число, переменная, унарная операция или бинарная операция
+ * Представляет собой универсальный узел, который может быть одним из пяти типов:
+ * число, переменная, унарная операция, бинарная операция или вызов функции.
+ * Узлы и строки дерева размещаются в арене и освобождаются вместе с ней
  */
 typedef struct ast_node_t {
     ast_node_type_t type;  // Тип узла
@@ -22,7 +28,7 @@ typedef struct ast_node_t {
         double number;     // Значение, если узел - число
         char* variable;    // Имя переменной, если узел - переменная
         struct {
-            char* oper;    // Имя операции (например, "sin", "cos", "!")
+            char oper;     // Символ операции (-, !)
             struct ast_node_t* operand;  // Операнд унарной операции
         } unary_op;
         struct {
@@ -30,44 +36,60 @@ typedef struct ast_node_t {
             struct ast_node_t* left;     // Левый операнд
             struct ast_node_t* right;    // Правый операнд
         } binary_op;
+        struct {
+            char* name;    // Имя функции
+            const function_t* function;  // Функция таблицы или NULL, если такой функции нет
+            struct ast_node_t* args[FUNCTION_MAX_ARITY]; // Аргументы
+            size_t num_args;             // Количество аргументов
+        } call;
     } value;
 } ast_node_t;
 
 /**
  * Создает узел AST для числового значения
+ * @param arena Арена, в которой размещается узел
  * @param value Числовое значение
  * @return Указатель на созданный узел AST или NULL при ошибке
  */
-ast_node_t* ast_create_number(double value);
+ast_node_t* ast_create_number(arena_t* arena, double value);
 
 /**
  * Создает узел AST для переменной
+ * @param arena Арена, в которой размещаются узел и копия имени
  * @param name Имя переменной
  * @return Указатель на созданный узел AST или NULL при ошибке
  */
-ast_node_t* ast_create_variable(const char* name);
+ast_node_t* ast_create_variable(arena_t* arena, const char* name);
 
 /**
  * Создает узел AST для унарной операции
- * @param op Название операции (например, "sin", "cos", "!")
+ * @param arena Арена, в которой размещается узел
+ * @param op Символ операции (-, !)
  * @param operand Указатель на узел AST операнда
  * @return Указатель на созданный узел AST или NULL при ошибке
  */
-ast_node_t* ast_create_unary_op(const char* op, ast_node_t* operand);
+ast_node_t* ast_create_unary_op(arena_t* arena, char op, ast_node_t* operand);
 
 /**
  * Создает узел AST для бинарной операции
+ * @param arena Арена, в которой размещается узел
  * @param op Символ операции (+, -, *, /, ^)
  * @param left Указатель на узел AST левого операнда
  * @param right Указатель на узел AST правого операнда
  * @return Указатель на созданный узел AST или NULL при ошибке
  */
-ast_node_t* ast_create_binary_op(char op, ast_node_t* left, ast_node_t* right);
+ast_node_t* ast_create_binary_op(arena_t* arena, char op, ast_node_t* left, ast_node_t* right);
 
 /**
- * Освобождает память, занятую узлом AST и всеми его дочерними узлами
- * @param node Указатель на узел AST для удаления
+ * Создает узел AST для вызова функции
+ * @param arena Арена, в которой размещаются узел и копия имени функции
+ * @param name Имя функции
+ * @param function Функция, в которую разрешено имя, или NULL, если такой функции нет
+ * @param args Массив указателей на узлы AST аргументов
+ * @param num_args Количество аргументов (не больше FUNCTION_MAX_ARITY)
+ * @return Указатель на созданный узел AST или NULL при ошибке
  */
-void ast_destroy(ast_node_t* node);
+ast_node_t* ast_create_call(arena_t* arena, const char* name, const function_t* function,
+                            ast_node_t* const* args, size_t num_args);
 
 #endif // AST_H
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+#include "calculator.h"
+
+/**
+ * Таблица переменных контекста калькулятора (см. symbol_table.h)
+ */
+typedef struct symbol_table_t symbol_table_t;
+
+/**
+ * Коды инструкций стековой машины
+ */
+typedef enum {
+    OP_CONST,   // Поместить на стек константу
+    OP_VAR,     // Поместить на стек значение переменной
+    OP_NEG,     // Унарный минус
+    OP_FACT,    // Факториал
+    OP_CALL1,   // Вызов функции одного аргумента
+    OP_CALL2,   // Вызов функции двух аргументов
+    OP_ADD,     // Сложение
+    OP_SUB,     // Вычитание
+    OP_MUL,     // Умножение
+    OP_DIV,     // Деление
+    OP_POW,     // Возведение в степень
+    OP_INVALID  // Неизвестная операция: вычисление завершается ошибкой
+} opcode_t;
+
+/**
+ * Инструкция стековой машины. Константа и указатель на вызываемую функцию хранятся
+ * прямо в инструкции, для переменной указываются слот таблицы переменных и номер
+ * переменной в программе
+ */
+typedef struct {
+    opcode_t op;              // Код инструкции
+    union {
+        double number;        // Константа для OP_CONST
+        struct {
+            uint32_t slot;    // Слот переменной в таблице переменных для OP_VAR
+            uint32_t index;   // Номер переменной среди переменных программы
+        } var;
+        unary_op_func unary;   // Функция для OP_CALL1
+        binary_op_func binary; // Функция для OP_CALL2
+        uint32_t operands;     // Количество операндов на стеке для OP_INVALID
+    } arg;
+} instruction_t;
+
+/**
+ * Программа стековой машины: инструкции в порядке обратной польской записи
+ * Используем неполный тип для скрытия реализации (паттерн "Непрозрачный указатель")
+ */
+typedef struct program_t program_t;
+
+/**
+ * Значение переменной в кадре вычисления. Кадр - массив таких значений по номерам
+ * переменных программы; у каждого потока свой кадр, а программа общая
+ */
+typedef struct {
+    double value;  // Значение переменной
+    bool defined;  // Задано ли значение
+} frame_value_t;
+
+/**
+ * Переводит AST в программу стековой машины
+ * Переменные связываются со слотами таблицы; отсутствующие в ней добавляются без значения
+ * @param node Корневой узел AST выражения
+ * @param symbols Таблица переменных, с которой выполняется программа
+ * @return Указатель на созданную программу или NULL при ошибке
+ */
+program_t* bytecode_compile(const ast_node_t* node, symbol_table_t* symbols);
+
+/**
+ * Освобождает ресурсы, занятые программой
+ * @param program Указатель на программу
+ */
+void bytecode_destroy(program_t* program);
+
+/**
+ * Выполняет программу
+ * Ошибки возвращаются в том же порядке, что и при обходе AST вычислителем
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных, с которой скомпилирована программа
+ * @param result Указатель для записи результата вычисления
+ * @return Код ошибки (CALC_SUCCESS при успехе)
+ */
+calc_error_t bytecode_execute(const program_t* program, const symbol_table_t* symbols, double* result);
+
+/**
+ * Возвращает количество переменных программы (размер кадра вычисления)
+ * @param program Указатель на программу
+ * @return Количество переменных
+ */
+size_t bytecode_num_vars(const program_t* program);
+
+/**
+ * Ищет номер переменной программы по имени
+ * @param program Указатель на программу
+ * @param name Имя переменной
+ * @param index Указатель для записи номера переменной в кадре
+ * @return true, если выражение использует переменную
+ */
+bool bytecode_find_var(const program_t* program, const char* name, size_t* index);
+
+/**
+ * Заполняет кадр текущими значениями переменных из таблицы
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных, с которой скомпилирована программа
+ * @param frame Кадр из bytecode_num_vars значений
+ */
+void bytecode_bind_frame(const program_t* program, const symbol_table_t* symbols, frame_value_t* frame);
+
+/**
+ * Выполняет программу со значениями переменных из кадра
+ * Программа только читается, поэтому одну программу можно одновременно
+ * выполнять в нескольких потоках, каждый со своим кадром
+ * @param program Указатель на программу
+ * @param frame Кадр из bytecode_num_vars значений
+ * @param result Указатель для записи результата вычисления
+ * @return Код ошибки (CALC_SUCCESS при успехе)
+ */
+calc_error_t bytecode_execute_frame(const program_t* program, const frame_value_t* frame, double* result);
+
+/**
+ * Выполняет программу для каждой строки пакета
+ * Строки обрабатываются блоками: каждая инструкция выполняется сразу для всего блока,
+ * поэтому циклы арифметических операций векторизуются компилятором
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных со значениями переменных, для которых нет столбца
+ * @param columns Массив столбцов переменных
+ * @param num_columns Количество столбцов
+ * @param count Количество строк пакета
+ * @param results Массив для записи count результатов (NAN для ошибочных строк)
+ * @param errors Массив для записи count кодов ошибок по строкам или NULL
+ * @return CALC_SUCCESS, если все строки вычислены успешно, иначе код ошибки первой ошибочной строки
+ */
+calc_error_t bytecode_execute_batch(const program_t* program, const symbol_table_t* symbols,
+                                    const calc_column_t* columns, size_t num_columns,
+                                    size_t count, double* results, unsigned char* errors);
+
+#endif // BYTECODE_H
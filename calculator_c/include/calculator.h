@@ -2,6 +2,7 @@
 #define CALCULATOR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * Коды ошибок калькулятора
@@ -61,6 +62,26 @@ calc_error_t calc_set_variable(calculator_ctx_t* ctx, const char* name, double v
  */
 calc_error_t calc_get_variable(calculator_ctx_t* ctx, const char* name, double* value);
 
+/**
+ * Возвращает номер слота переменной для быстрого доступа по номеру
+ * Переменная, которой еще нет в контексте, добавляется без значения. Номер слота
+ * не меняется до уничтожения контекста
+ * @param ctx Указатель на контекст калькулятора
+ * @param name Имя переменной
+ * @param slot Указатель для записи номера слота
+ * @return Код ошибки (CALC_SUCCESS при успехе)
+ */
+calc_error_t calc_resolve_variable(calculator_ctx_t* ctx, const char* name, size_t* slot);
+
+/**
+ * Устанавливает значение переменной по номеру слота без поиска по имени
+ * @param ctx Указатель на контекст калькулятора
+ * @param slot Номер слота, полученный от calc_resolve_variable
+ * @param value Значение переменной
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR для несуществующего слота)
+ */
+calc_error_t calc_set_variable_by_slot(calculator_ctx_t* ctx, size_t slot, double value);
+
 /**
  * Вычисляет математическое выражение
  * @param ctx Указатель на контекст калькулятора
@@ -70,6 +91,126 @@ calc_error_t calc_get_variable(calculator_ctx_t* ctx, const char* name, double*
  */
 calc_error_t calc_evaluate(calculator_ctx_t* ctx, const char* expression, double* result);
 
+/**
+ * Скомпилированное выражение: результат однократного разбора, пригодный для
+ * многократного вычисления с разными значениями переменных
+ * После компиляции выражение не изменяется, поэтому его можно одновременно
+ * вычислять в нескольких потоках, каждый со своим кадром (calc_frame_t)
+ * Используем неполный тип для скрытия реализации (паттерн "Непрозрачный указатель")
+ */
+typedef struct calc_expression_t calc_expression_t;
+
+/**
+ * Разбирает выражение один раз для последующих вычислений через calc_eval_compiled
+ * Переменные выражения связываются со слотами переменных контекста, поэтому
+ * выражение вычисляется только в том контексте, в котором скомпилировано
+ * @param ctx Указатель на контекст калькулятора
+ * @param expression Строка с математическим выражением
+ * @param compiled Указатель для записи скомпилированного выражения
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_SYNTAX при ошибке разбора)
+ */
+calc_error_t calc_compile(calculator_ctx_t* ctx, const char* expression, calc_expression_t** compiled);
+
+/**
+ * Вычисляет скомпилированное выражение с текущими значениями переменных контекста
+ * @param ctx Указатель на контекст калькулятора
+ * @param compiled Скомпилированное выражение
+ * @param result Указатель для записи результата вычисления
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_INVALID_OPERATION для чужого контекста)
+ */
+calc_error_t calc_eval_compiled(calculator_ctx_t* ctx, const calc_expression_t* compiled, double* result);
+
+/**
+ * Столбец значений переменной для пакетного вычисления
+ */
+typedef struct {
+    const char* name;     // Имя переменной
+    const double* values; // Значения переменной, по одному на строку пакета
+} calc_column_t;
+
+/**
+ * Вычисляет скомпилированное выражение для каждой строки пакета
+ * Значения переменных берутся из столбцов, а переменных без столбца - из контекста.
+ * Ошибка в строке (например, деление на ноль) не прерывает вычисление остальных:
+ * ее код записывается в маску ошибок, а результатом строки становится NAN
+ * @param ctx Указатель на контекст калькулятора
+ * @param compiled Скомпилированное выражение
+ * @param columns Массив столбцов переменных
+ * @param num_columns Количество столбцов
+ * @param count Количество строк пакета
+ * @param results Массив для записи count результатов
+ * @param errors Массив для записи count кодов ошибок (calc_error_t) по строкам или NULL
+ * @return CALC_SUCCESS, если все строки вычислены успешно, иначе код ошибки первой ошибочной строки
+ */
+calc_error_t calc_eval_batch(calculator_ctx_t* ctx, const calc_expression_t* compiled,
+                             const calc_column_t* columns, size_t num_columns,
+                             size_t count, double* results, unsigned char* errors);
+
+/**
+ * Освобождает ресурсы, занятые скомпилированным выражением
+ * Кадры выражения должны быть уничтожены раньше него
+ * @param compiled Скомпилированное выражение (допускается NULL)
+ */
+void calc_free_compiled(calc_expression_t* compiled);
+
+/**
+ * Кадр вычисления: значения переменных одного скомпилированного выражения.
+ * Каждый поток вычисляет общее выражение в своем кадре; кадр не обращается
+ * к контексту калькулятора и не должен использоваться несколькими потоками одновременно
+ * Используем неполный тип для скрытия реализации (паттерн "Непрозрачный указатель")
+ */
+typedef struct calc_frame_t calc_frame_t;
+
+/**
+ * Создает кадр вычисления для скомпилированного выражения
+ * Значения переменных копируются из контекста, в котором скомпилировано выражение,
+ * поэтому контекст не должен изменяться одновременно с созданием кадра
+ * @param compiled Скомпилированное выражение
+ * @return Указатель на созданный кадр или NULL при ошибке
+ */
+calc_frame_t* calc_frame_create(const calc_expression_t* compiled);
+
+/**
+ * Освобождает ресурсы, занятые кадром вычисления
+ * @param frame Указатель на кадр (допускается NULL)
+ */
+void calc_frame_destroy(calc_frame_t* frame);
+
+/**
+ * Возвращает номер переменной в кадре для быстрого доступа по номеру
+ * @param frame Указатель на кадр
+ * @param name Имя переменной
+ * @param index Указатель для записи номера переменной
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR, если выражение не использует переменную)
+ */
+calc_error_t calc_frame_find_variable(const calc_frame_t* frame, const char* name, size_t* index);
+
+/**
+ * Устанавливает значение переменной кадра по номеру
+ * @param frame Указатель на кадр
+ * @param index Номер переменной, полученный от calc_frame_find_variable
+ * @param value Значение переменной
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR для несуществующего номера)
+ */
+calc_error_t calc_frame_set(calc_frame_t* frame, size_t index, double value);
+
+/**
+ * Устанавливает значение переменной кадра по имени
+ * @param frame Указатель на кадр
+ * @param name Имя переменной
+ * @param value Значение переменной
+ * @return Код ошибки (CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR, если выражение не использует переменную)
+ */
+calc_error_t calc_frame_set_variable(calc_frame_t* frame, const char* name, double value);
+
+/**
+ * Вычисляет скомпилированное выражение со значениями переменных из кадра
+ * @param frame Указатель на кадр
+ * @param result Указатель для записи результата вычисления
+ * @return Код ошибки (CALC_SUCCESS при успехе)
+ */
+calc_error_t calc_eval_frame(const calc_frame_t* frame, double* result);
+
 /**
  * Возвращает текстовое описание ошибки по её коду
  * @param error Код ошибки
@@ -92,7 +233,10 @@ typedef double (*unary_op_func)(double);
 typedef double (*binary_op_func)(double, double);
 
 /**
- * Регистрирует новую унарную операцию
+ * Регистрирует новую унарную операцию - функцию, вызываемую в выражениях как name(x)
+ * Имя разрешается в функцию при компиляции выражения; повторная регистрация имени
+ * заменяет функцию только для выражений, скомпилированных после нее.
+ * Функция должна зависеть только от аргумента: вызовы с константами вычисляются при компиляции
  * @param ctx Указатель на контекст калькулятора
  * @param name Имя операции (например, "tan" для тангенса)
  * @param func Указатель на функцию, реализующую операцию
@@ -101,9 +245,10 @@ typedef double (*binary_op_func)(double, double);
 calc_error_t calc_register_unary_op(calculator_ctx_t* ctx, const char* name, unary_op_func func);
 
 /**
- * Регистрирует новую бинарную операцию
+ * Регистрирует новую бинарную операцию - функцию, вызываемую в выражениях как name(a, b)
+ * Разрешение имени и замена функции выполняются так же, как для унарных операций
  * @param ctx Указатель на контекст калькулятора
- * @param name Имя операции (символ операции)
+ * @param name Имя операции (идентификатор, например "mod")
  * @param func Указатель на функцию, реализующую операцию
  * @return Код ошибки (CALC_SUCCESS при успехе)
  */
@@ -4,6 +4,11 @@
 #include "ast.h"
 #include "calculator.h"
 
+/**
+ * Значение встроенной константы PI
+ */
+#define CALC_PI 3.1415926535
+
 /**
  * Структура вычислителя выражений
  * Используем неполный тип для скрытия реализации (паттерн "Непрозрачный указатель")
@@ -32,4 +37,11 @@ void evaluator_destroy(evaluator_t* eval);
  */
 calc_error_t evaluator_evaluate(evaluator_t* eval, ast_node_t* node, double* result);
 
+/**
+ * Вычисляет факториал
+ * @param n Аргумент (целое неотрицательное число)
+ * @return Факториал n или NAN, если n не является целым неотрицательным числом
+ */
+double evaluator_factorial(double n);
+
 #endif // EVALUATOR_H
\ No newline at end of file
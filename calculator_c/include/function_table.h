@@ -0,0 +1,76 @@
+#ifndef FUNCTION_TABLE_H
+#define FUNCTION_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "calculator.h"
+
+/**
+ * Наибольшее количество аргументов функции
+ */
+#define FUNCTION_MAX_ARITY 2
+
+/**
+ * Функция, вызываемая в выражениях по имени: встроенная (sin, cos) или
+ * зарегистрированная пользователем. Имя разрешается в указатель на функцию
+ * один раз при разборе, поэтому при вычислении строки не сравниваются
+ */
+typedef struct {
+    char* name;                  // Имя функции
+    size_t arity;                // Количество аргументов (1 или 2)
+    union {
+        unary_op_func unary;     // Реализация функции одного аргумента
+        binary_op_func binary;   // Реализация функции двух аргументов
+    } func;
+} function_t;
+
+/**
+ * Таблица функций контекста калькулятора
+ */
+typedef struct function_table_t {
+    function_t* functions;  // Функции в порядке регистрации
+    size_t count;           // Количество функций
+    size_t capacity;        // Емкость массива функций
+} function_table_t;
+
+/**
+ * Инициализирует таблицу встроенными функциями
+ * @param table Указатель на таблицу
+ * @return true при успехе, false при ошибке выделения памяти
+ */
+bool function_table_init(function_table_t* table);
+
+/**
+ * Освобождает ресурсы, занятые таблицей функций
+ * @param table Указатель на таблицу
+ */
+void function_table_free(function_table_t* table);
+
+/**
+ * Ищет функцию по имени и количеству аргументов
+ * @param table Указатель на таблицу
+ * @param name Имя функции
+ * @param arity Количество аргументов
+ * @return Указатель на функцию или NULL, если такой функции нет
+ */
+const function_t* function_table_find(const function_table_t* table, const char* name, size_t arity);
+
+/**
+ * Регистрирует функцию одного аргумента, заменяя функцию с тем же именем и количеством аргументов
+ * @param table Указатель на таблицу
+ * @param name Имя функции (идентификатор)
+ * @param func Реализация функции
+ * @return true при успехе, false для недопустимого имени или при ошибке выделения памяти
+ */
+bool function_table_add_unary(function_table_t* table, const char* name, unary_op_func func);
+
+/**
+ * Регистрирует функцию двух аргументов, заменяя функцию с тем же именем и количеством аргументов
+ * @param table Указатель на таблицу
+ * @param name Имя функции (идентификатор)
+ * @param func Реализация функции
+ * @return true при успехе, false для недопустимого имени или при ошибке выделения памяти
+ */
+bool function_table_add_binary(function_table_t* table, const char* name, binary_op_func func);
+
+#endif // FUNCTION_TABLE_H
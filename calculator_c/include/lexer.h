@@ -1,6 +1,8 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "arena.h"
+
 /**
  * Типы лексем (токенов), выделяемых лексическим анализатором
  */
@@ -14,6 +16,7 @@ typedef enum {
     TOKEN_RBRACE,     // Закрывающая фигурная скобка }
     TOKEN_LBRACKET,   // Открывающая квадратная скобка [
     TOKEN_RBRACKET,   // Закрывающая квадратная скобка ]
+    TOKEN_COMMA,      // Запятая между аргументами функции
     TOKEN_EOF,        // Конец входной строки
     TOKEN_ERROR       // Ошибка лексического анализа
 } token_type_t;
@@ -26,7 +29,7 @@ typedef struct {
     token_type_t type;  // Тип лексемы
     union {
         double number;    // Значение, если лексема - число
-        char* identifier; // Имя, если лексема - идентификатор
+        char* identifier; // Имя, если лексема - идентификатор (размещается в арене анализатора)
         char oper;        // Символ, если лексема - оператор
     } value;
     int position;       // Позиция лексемы во входной строке (для сообщений об ошибках)
@@ -40,16 +43,12 @@ typedef struct lexer_t lexer_t;
 
 /**
  * Создает новый лексический анализатор для указанной входной строки
+ * Анализатор и имена идентификаторов размещаются в арене и освобождаются вместе с ней
  * @param input Входная строка для анализа
+ * @param arena Арена разбора
  * @return Указатель на созданный лексический анализатор или NULL при ошибке
  */
-lexer_t* lexer_create(const char* input);
-
-/**
- * Освобождает ресурсы, занятые лексическим анализатором
- * @param lexer Указатель на лексический анализатор
- */
-void lexer_destroy(lexer_t* lexer);
+lexer_t* lexer_create(const char* input, arena_t* arena);
 
 /**
  * Извлекает следующую лексему из входной строки
@@ -58,10 +57,4 @@ void lexer_destroy(lexer_t* lexer);
  */
 token_t lexer_next_token(lexer_t* lexer);
 
-/**
- * Освобождает ресурсы, занятые лексемой (если нужно)
- * @param token Указатель на лексему
- */
-void token_destroy(token_t* token);
-
 #endif // LEXER_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+/**
+ * Упрощает AST перед компиляцией: сворачивает константные поддеревья (в том числе
+ * вызовы функций и ! от констант и встроенную константу PI) и применяет тождества
+ * x * 1, 1 * x, x / 1, x ^ 1, x - 0, x + (-0) и -(-x)
+ * Упрощенное дерево дает те же результаты по IEEE 754 и те же коды ошибок в том же
+ * порядке: поддерево, вычисление которого завершается ошибкой, не сворачивается,
+ * а переменные не удаляются из выражения. Поэтому x + 0 не упрощается (-0 + 0 = +0)
+ * Функции таблицы функций должны зависеть только от своих аргументов
+ * Узлы изменяются на месте и остаются в арене исходного дерева
+ * @param node Корневой узел AST выражения
+ * @return Корневой узел упрощенного AST или NULL, если node равен NULL
+ */
+ast_node_t* optimizer_simplify(ast_node_t* node);
+
+#endif // OPTIMIZER_H
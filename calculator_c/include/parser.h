@@ -12,16 +12,14 @@ typedef struct parser_t parser_t;
 
 /**
  * Создает новый синтаксический анализатор
+ * Анализатор и построенное им AST размещаются в арене и освобождаются вместе с ней.
+ * Имена вызываемых функций разрешаются по таблице функций при разборе
  * @param lexer Указатель на лексический анализатор, который будет использоваться для получения лексем
+ * @param arena Арена разбора
+ * @param functions Таблица функций, которая не должна меняться, пока используется AST
  * @return Указатель на созданный синтаксический анализатор или NULL при ошибке
  */
-parser_t* parser_create(lexer_t* lexer);
-
-/**
- * Освобождает ресурсы, занятые синтаксическим анализатором
- * @param parser Указатель на синтаксический анализатор
- */
-void parser_destroy(parser_t* parser);
+parser_t* parser_create(lexer_t* lexer, arena_t* arena, const function_table_t* functions);
 
 /**
  * Разбирает выражение и строит абстрактное синтаксическое дерево
@@ -0,0 +1,59 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Переменная таблицы символов. Номер переменной (слот) не меняется за все время
+ * жизни таблицы, поэтому скомпилированные выражения обращаются к значению по слоту
+ */
+typedef struct {
+    char* name;    // Имя переменной
+    double value;  // Значение переменной
+    bool defined;  // Задано ли значение (слот может быть занят именем до присваивания)
+} symbol_t;
+
+/**
+ * Таблица символов: массив переменных в порядке добавления и хеш-индекс
+ * с открытой адресацией для поиска слота по имени
+ */
+typedef struct symbol_table_t {
+    symbol_t* symbols;   // Переменные, индекс - номер слота
+    size_t count;        // Количество переменных
+    size_t capacity;     // Емкость массива переменных
+    size_t* index;       // Хеш-индекс: номер слота + 1 или 0 для свободной ячейки
+    size_t index_size;   // Размер хеш-индекса (степень двойки)
+} symbol_table_t;
+
+/**
+ * Инициализирует пустую таблицу символов
+ * @param table Указатель на таблицу
+ */
+void symbol_table_init(symbol_table_t* table);
+
+/**
+ * Освобождает ресурсы, занятые таблицей символов
+ * @param table Указатель на таблицу
+ */
+void symbol_table_free(symbol_table_t* table);
+
+/**
+ * Ищет слот переменной по имени
+ * @param table Указатель на таблицу
+ * @param name Имя переменной
+ * @param slot Указатель для записи номера слота
+ * @return true, если переменная есть в таблице
+ */
+bool symbol_table_find(const symbol_table_t* table, const char* name, size_t* slot);
+
+/**
+ * Возвращает слот переменной, добавляя ее без значения, если ее еще нет
+ * @param table Указатель на таблицу
+ * @param name Имя переменной
+ * @param slot Указатель для записи номера слота
+ * @return true при успехе, false при ошибке выделения памяти
+ */
+bool symbol_table_intern(symbol_table_t* table, const char* name, size_t* slot);
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,92 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+// Выравнивание выделяемой памяти, подходящее для любого типа
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+// Наименьший размер следующего блока арены
+#define MIN_BLOCK_SIZE 1024
+
+/**
+ * Блок арены. Данные следуют сразу за заголовком
+ */
+typedef struct arena_block_t {
+    struct arena_block_t* next;  // Предыдущий заполненный блок
+    size_t size;                 // Размер данных блока
+    size_t used;                 // Занятая часть данных блока
+    max_align_t data[];          // Данные блока
+} arena_block_t;
+
+struct arena_t {
+    arena_block_t* current;      // Блок, из которого выделяется память
+    arena_block_t* first;        // Первый блок, размещенный в одном выделении с ареной
+    size_t next_size;            // Размер следующего блока
+};
+
+/**
+ * Округляет размер вверх до кратного выравниванию.
+ *
+ * @param size Размер в байтах
+ * @return Округленный размер
+ */
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+arena_t* arena_create(size_t initial_size) {
+    initial_size = align_size(initial_size);
+    const size_t header = align_size(sizeof(arena_t));
+    arena_t* arena = malloc(header + sizeof(arena_block_t) + initial_size);
+    if (arena) {
+        arena->first = (arena_block_t*)((unsigned char*)arena + header);
+        arena->first->next = NULL;
+        arena->first->size = initial_size;
+        arena->first->used = 0;
+        arena->current = arena->first;
+        arena->next_size = initial_size > MIN_BLOCK_SIZE ? initial_size : MIN_BLOCK_SIZE;
+    }
+    return arena;
+}
+
+void arena_destroy(arena_t* arena) {
+    if (arena) {
+        // Первый блок - часть самой арены, остальные освобождаются по цепочке
+        arena_block_t* block = arena->current;
+        while (block != arena->first) {
+            arena_block_t* next = block->next;
+            free(block);
+            block = next;
+        }
+        free(arena);
+    }
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = align_size(size ? size : 1);
+    arena_block_t* block = arena->current;
+    if (block->size - block->used < size) {
+        // Блоки растут вдвое, чтобы число выделений оставалось логарифмическим
+        size_t block_size = arena->next_size > size ? arena->next_size : size;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (!block) return NULL;
+        block->next = arena->current;
+        block->size = block_size;
+        block->used = 0;
+        arena->current = block;
+        arena->next_size = 2 * block_size;
+    }
+    void* memory = (unsigned char*)block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t length) {
+    char* copy = arena_alloc(arena, length + 1);
+    if (copy) {
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
@@ -1,16 +1,29 @@
 #include "ast.h"
-#include <stdlib.h>
 #include <string.h>
 
+/**
+ * Выделяет в арене узел AST заданного типа
+ * @param arena Арена
+ * @param type Тип узла
+ * @return Указатель на узел или NULL при ошибке выделения памяти
+ */
+static ast_node_t* ast_alloc(arena_t* arena, ast_node_type_t type) {
+    ast_node_t* node = arena_alloc(arena, sizeof(ast_node_t));
+    if (node) {
+        node->type = type;
+    }
+    return node;
+}
+
 /**
  * Создает узел AST для числового значения
+ * @param arena Арена, в которой размещается узел
  * @param value Числовое значение
  * @return Указатель на созданный узел AST или NULL при ошибке выделения памяти
  */
-ast_node_t* ast_create_number(double value) {
-    ast_node_t* node = malloc(sizeof(ast_node_t));
+ast_node_t* ast_create_number(arena_t* arena, double value) {
+    ast_node_t* node = ast_alloc(arena, AST_NUMBER);
     if (node) {
-        node->type = AST_NUMBER;
         node->value.number = value;
     }
     return node;
@@ -18,31 +31,33 @@ ast_node_t* ast_create_number(double value) {
 
 /**
  * Создает узел AST для переменной
+ * @param arena Арена, в которой размещаются узел и копия имени
  * @param name Имя переменной
  * @return Указатель на созданный узел AST или NULL при ошибке выделения памяти
  */
-ast_node_t* ast_create_variable(const char* name) {
-    ast_node_t* node = malloc(sizeof(ast_node_t));
+ast_node_t* ast_create_variable(arena_t* arena, const char* name) {
+    ast_node_t* node = ast_alloc(arena, AST_VARIABLE);
     if (node) {
-        node->type = AST_VARIABLE;
         // Создаем копию строки с именем переменной
-        node->value.variable = strdup(name);
+        node->value.variable = arena_strndup(arena, name, strlen(name));
+        if (!node->value.variable) return NULL;
     }
     return node;
 }
 
 /**
  * Создает узел AST для унарной операции
- * @param op Название операции (например, "sin", "cos", "!")
+ * @param arena Арена, в которой размещается узел
+ * @param op Символ операции (-, !)
  * @param operand Указатель на узел AST операнда
  * @return Указатель на созданный узел AST или NULL при ошибке выделения памяти
  */
-ast_node_t* ast_create_unary_op(const char* op, ast_node_t* operand) {
-    ast_node_t* node = malloc(sizeof(ast_node_t));
+ast_node_t* ast_create_unary_op(arena_t* arena, char op, ast_node_t* operand) {
+    if (!operand) return NULL;
+    
+    ast_node_t* node = ast_alloc(arena, AST_UNARY_OP);
     if (node) {
-        node->type = AST_UNARY_OP;
-        // Создаем копию строки с именем оператора
-        node->value.unary_op.oper = strdup(op);
+        node->value.unary_op.oper = op;
         node->value.unary_op.operand = operand;
     }
     return node;
@@ -50,15 +65,17 @@ ast_node_t* ast_create_unary_op(const char* op, ast_node_t* operand) {
 
 /**
  * Создает узел AST для бинарной операции
+ * @param arena Арена, в которой размещается узел
  * @param op Символ операции (+, -, *, /, ^)
  * @param left Указатель на узел AST левого операнда
  * @param right Указатель на узел AST правого операнда
  * @return Указатель на созданный узел AST или NULL при ошибке выделения памяти
  */
-ast_node_t* ast_create_binary_op(char op, ast_node_t* left, ast_node_t* right) {
-    ast_node_t* node = malloc(sizeof(ast_node_t));
+ast_node_t* ast_create_binary_op(arena_t* arena, char op, ast_node_t* left, ast_node_t* right) {
+    if (!left || !right) return NULL;
+    
+    ast_node_t* node = ast_alloc(arena, AST_BINARY_OP);
     if (node) {
-        node->type = AST_BINARY_OP;
         node->value.binary_op.oper = op;
         node->value.binary_op.left = left;
         node->value.binary_op.right = right;
@@ -67,34 +84,31 @@ ast_node_t* ast_create_binary_op(char op, ast_node_t* left, ast_node_t* right) {
 }
 
 /**
- * Освобождает память, занятую узлом AST и всеми его дочерними узлами
- * Рекурсивно обходит дерево и освобождает память для всех узлов
- * @param node Указатель на узел AST для удаления
+ * Создает узел AST для вызова функции
+ * @param arena Арена, в которой размещаются узел и копия имени функции
+ * @param name Имя функции
+ * @param function Функция, в которую разрешено имя, или NULL, если такой функции нет
+ * @param args Массив указателей на узлы AST аргументов
+ * @param num_args Количество аргументов (не больше FUNCTION_MAX_ARITY)
+ * @return Указатель на созданный узел AST или NULL при ошибке выделения памяти
  */
-void ast_destroy(ast_node_t* node) {
-    if (!node) return;
-    
-    // Обрабатываем различные типы узлов
-    switch (node->type) {
-        case AST_VARIABLE:
-            // Освобождаем память строки с именем переменной
-            free(node->value.variable);
-            break;
-        case AST_UNARY_OP:
-            // Освобождаем память строки с именем операции и рекурсивно удаляем операнд
-            free(node->value.unary_op.oper);
-            ast_destroy(node->value.unary_op.operand);
-            break;
-        case AST_BINARY_OP:
-            // Рекурсивно удаляем левый и правый операнды
-            ast_destroy(node->value.binary_op.left);
-            ast_destroy(node->value.binary_op.right);
-            break;
-        default:
-            // Для числовых узлов дополнительной очистки не требуется
-            break;
+ast_node_t* ast_create_call(arena_t* arena, const char* name, const function_t* function,
+                            ast_node_t* const* args, size_t num_args) {
+    if (num_args == 0 || num_args > FUNCTION_MAX_ARITY) return NULL;
+    for (size_t i = 0; i < num_args; i++) {
+        if (!args[i]) return NULL;
     }
     
-    // Освобождаем память самого узла
-    free(node);
-}
\ No newline at end of file
+    ast_node_t* node = ast_alloc(arena, AST_CALL);
+    if (node) {
+        // Создаем копию строки с именем функции
+        node->value.call.name = arena_strndup(arena, name, strlen(name));
+        if (!node->value.call.name) return NULL;
+        node->value.call.function = function;
+        node->value.call.num_args = num_args;
+        for (size_t i = 0; i < num_args; i++) {
+            node->value.call.args[i] = args[i];
+        }
+    }
+    return node;
+}
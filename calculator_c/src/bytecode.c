@@ -0,0 +1,490 @@
+#include "bytecode.h"
+#include "evaluator.h"
+#include "symbol_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Глубина стека, при которой стек вычисления размещается в локальном буфере
+#define LOCAL_STACK_DEPTH 64
+
+struct program_t {
+    instruction_t* code;   // Инструкции в порядке выполнения
+    size_t length;         // Количество инструкций
+    size_t capacity;       // Емкость массива инструкций
+    uint32_t* vars;        // Слоты переменных, на которые ссылаются инструкции OP_VAR
+    char** names;          // Имена переменных в порядке их номеров в программе
+    size_t num_vars;       // Количество переменных
+    size_t stack_depth;    // Наибольшая глубина стека при выполнении
+    size_t depth;          // Текущая глубина стека (только при компиляции)
+};
+
+/**
+ * Добавляет инструкцию в конец программы и учитывает ее влияние на глубину стека.
+ *
+ * @param program Указатель на программу
+ * @param instruction Добавляемая инструкция
+ * @param stack_effect Изменение глубины стека после выполнения инструкции
+ * @return true при успехе, false при ошибке выделения памяти
+ */
+static bool emit(program_t* program, instruction_t instruction, int stack_effect) {
+    if (program->length == program->capacity) {
+        size_t capacity = program->capacity ? 2 * program->capacity : 16;
+        instruction_t* code = realloc(program->code, capacity * sizeof(instruction_t));
+        if (!code) return false;
+        program->code = code;
+        program->capacity = capacity;
+    }
+    program->code[program->length++] = instruction;
+    
+    program->depth += stack_effect;
+    if (program->depth > program->stack_depth) {
+        program->stack_depth = program->depth;
+    }
+    return true;
+}
+
+/**
+ * Связывает переменную со слотом таблицы и возвращает ее номер среди переменных программы.
+ *
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных
+ * @param name Имя переменной
+ * @param instruction Инструкция OP_VAR, в которую записываются слот и номер переменной
+ * @return true при успехе, false при ошибке выделения памяти
+ */
+static bool bind_variable(program_t* program, symbol_table_t* symbols, const char* name,
+                          instruction_t* instruction) {
+    size_t slot;
+    if (!symbol_table_intern(symbols, name, &slot) || slot > UINT32_MAX) return false;
+    instruction->arg.var.slot = (uint32_t)slot;
+    
+    for (size_t i = 0; i < program->num_vars; i++) {
+        if (program->vars[i] == slot) {
+            instruction->arg.var.index = (uint32_t)i;
+            return true;
+        }
+    }
+    
+    uint32_t* vars = realloc(program->vars, (program->num_vars + 1) * sizeof(uint32_t));
+    if (!vars) return false;
+    program->vars = vars;
+    char** names = realloc(program->names, (program->num_vars + 1) * sizeof(char*));
+    if (!names) return false;
+    program->names = names;
+    
+    // Имя копируется, чтобы программа не зависела от таблицы переменных при вычислении в кадрах
+    char* copy = strdup(name);
+    if (!copy) return false;
+    vars[program->num_vars] = (uint32_t)slot;
+    names[program->num_vars] = copy;
+    instruction->arg.var.index = (uint32_t)program->num_vars++;
+    return true;
+}
+
+/**
+ * Возвращает код инструкции унарной операции по ее символу.
+ * Неизвестная операция компилируется в OP_INVALID, чтобы ошибка, как и при
+ * обходе AST, возникала только после вычисления операнда.
+ *
+ * @param oper Символ операции
+ * @return Код инструкции
+ */
+static opcode_t unary_opcode(char oper) {
+    switch (oper) {
+        case '-': return OP_NEG;
+        case '!': return OP_FACT;
+        default: return OP_INVALID;
+    }
+}
+
+/**
+ * Возвращает код инструкции бинарной операции по ее символу.
+ *
+ * @param oper Символ операции
+ * @return Код инструкции
+ */
+static opcode_t binary_opcode(char oper) {
+    switch (oper) {
+        case '+': return OP_ADD;
+        case '-': return OP_SUB;
+        case '*': return OP_MUL;
+        case '/': return OP_DIV;
+        case '^': return OP_POW;
+        default: return OP_INVALID;
+    }
+}
+
+/**
+ * Рекурсивно переводит поддерево AST в инструкции: сначала операнды, затем операция.
+ *
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных
+ * @param node Узел AST
+ * @return true при успехе, false при ошибке
+ */
+static bool compile_node(program_t* program, symbol_table_t* symbols, const ast_node_t* node) {
+    if (!node) return false;
+    
+    instruction_t instruction = {0};
+    switch (node->type) {
+        case AST_NUMBER:
+            instruction.op = OP_CONST;
+            instruction.arg.number = node->value.number;
+            return emit(program, instruction, 1);
+        
+        case AST_VARIABLE:
+            // Встроенная константа подставляется прямо в инструкцию
+            if (strcmp(node->value.variable, "PI") == 0) {
+                instruction.op = OP_CONST;
+                instruction.arg.number = CALC_PI;
+                return emit(program, instruction, 1);
+            }
+            instruction.op = OP_VAR;
+            if (!bind_variable(program, symbols, node->value.variable, &instruction)) return false;
+            return emit(program, instruction, 1);
+        
+        case AST_UNARY_OP:
+            if (!compile_node(program, symbols, node->value.unary_op.operand)) return false;
+            instruction.op = unary_opcode(node->value.unary_op.oper);
+            instruction.arg.operands = 1;
+            return emit(program, instruction, 0);
+        
+        case AST_BINARY_OP:
+            if (!compile_node(program, symbols, node->value.binary_op.left)) return false;
+            if (!compile_node(program, symbols, node->value.binary_op.right)) return false;
+            instruction.op = binary_opcode(node->value.binary_op.oper);
+            instruction.arg.operands = 2;
+            return emit(program, instruction, -1);
+        
+        case AST_CALL: {
+            const size_t num_args = node->value.call.num_args;
+            for (size_t i = 0; i < num_args; i++) {
+                if (!compile_node(program, symbols, node->value.call.args[i])) return false;
+            }
+            
+            // Указатель на функцию записывается в инструкцию: при выполнении имя не ищется
+            const function_t* function = node->value.call.function;
+            if (!function) {
+                instruction.op = OP_INVALID;
+                instruction.arg.operands = (uint32_t)num_args;
+            } else if (function->arity == 1) {
+                instruction.op = OP_CALL1;
+                instruction.arg.unary = function->func.unary;
+            } else {
+                instruction.op = OP_CALL2;
+                instruction.arg.binary = function->func.binary;
+            }
+            return emit(program, instruction, 1 - (int)num_args);
+        }
+    }
+    return false;
+}
+
+program_t* bytecode_compile(const ast_node_t* node, symbol_table_t* symbols) {
+    program_t* program = calloc(1, sizeof(program_t));
+    if (!program) return NULL;
+    
+    if (!compile_node(program, symbols, node)) {
+        bytecode_destroy(program);
+        return NULL;
+    }
+    return program;
+}
+
+void bytecode_destroy(program_t* program) {
+    if (program) {
+        for (size_t i = 0; i < program->num_vars; i++) {
+            free(program->names[i]);
+        }
+        free(program->names);
+        free(program->vars);
+        free(program->code);
+        free(program);
+    }
+}
+
+size_t bytecode_num_vars(const program_t* program) {
+    return program->num_vars;
+}
+
+bool bytecode_find_var(const program_t* program, const char* name, size_t* index) {
+    for (size_t i = 0; i < program->num_vars; i++) {
+        if (strcmp(program->names[i], name) == 0) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void bytecode_bind_frame(const program_t* program, const symbol_table_t* symbols, frame_value_t* frame) {
+    for (size_t i = 0; i < program->num_vars; i++) {
+        const symbol_t* symbol = &symbols->symbols[program->vars[i]];
+        frame[i].value = symbol->value;
+        frame[i].defined = symbol->defined;
+    }
+}
+
+/**
+ * Выполняет программу со значениями переменных из таблицы или из кадра.
+ * Программа только читается, поэтому ее можно выполнять одновременно в нескольких потоках.
+ *
+ * @param program Указатель на программу
+ * @param symbols Таблица переменных (используется, если frame равен NULL)
+ * @param frame Значения переменных по номерам переменных программы или NULL
+ * @param result Указатель для записи результата вычисления
+ * @return Код ошибки (CALC_SUCCESS при успехе)
+ */
+static calc_error_t execute(const program_t* program, const symbol_table_t* symbols,
+                            const frame_value_t* frame, double* result) {
+    if (!program || !result) return CALC_ERROR_SYNTAX;
+    
+    // Стек вычисления: для обычных выражений - локальный буфер без выделения памяти
+    double local_stack[LOCAL_STACK_DEPTH];
+    double* stack = local_stack;
+    if (program->stack_depth > LOCAL_STACK_DEPTH) {
+        stack = malloc(program->stack_depth * sizeof(double));
+        if (!stack) return CALC_ERROR_SYNTAX;
+    }
+    
+    calc_error_t error = CALC_SUCCESS;
+    double* sp = stack;  // Позиция над вершиной стека
+    const instruction_t* end = program->code + program->length;
+    for (const instruction_t* ip = program->code; ip < end; ip++) {
+        switch (ip->op) {
+            case OP_CONST:
+                *sp++ = ip->arg.number;
+                break;
+            case OP_VAR: {
+                bool defined;
+                if (frame) {
+                    defined = frame[ip->arg.var.index].defined;
+                    *sp = frame[ip->arg.var.index].value;
+                } else {
+                    defined = symbols->symbols[ip->arg.var.slot].defined;
+                    *sp = symbols->symbols[ip->arg.var.slot].value;
+                }
+                if (!defined) {
+                    error = CALC_ERROR_UNDEFINED_VAR;
+                    goto done;
+                }
+                sp++;
+                break;
+            }
+            case OP_NEG:
+                sp[-1] = -sp[-1];
+                break;
+            case OP_FACT:
+                sp[-1] = evaluator_factorial(sp[-1]);
+                if (isnan(sp[-1])) {
+                    error = CALC_ERROR_INVALID_OPERATION;
+                    goto done;
+                }
+                break;
+            case OP_CALL1:
+                sp[-1] = ip->arg.unary(sp[-1]);
+                break;
+            case OP_CALL2:
+                sp--;
+                sp[-1] = ip->arg.binary(sp[-1], sp[0]);
+                break;
+            case OP_ADD:
+                sp--;
+                sp[-1] = sp[-1] + sp[0];
+                break;
+            case OP_SUB:
+                sp--;
+                sp[-1] = sp[-1] - sp[0];
+                break;
+            case OP_MUL:
+                sp--;
+                sp[-1] = sp[-1] * sp[0];
+                break;
+            case OP_DIV:
+                sp--;
+                if (sp[0] == 0) {
+                    error = CALC_ERROR_INVALID_OPERATION;
+                    goto done;
+                }
+                sp[-1] = sp[-1] / sp[0];
+                break;
+            case OP_POW:
+                sp--;
+                sp[-1] = pow(sp[-1], sp[0]);
+                break;
+            case OP_INVALID:
+                error = CALC_ERROR_INVALID_OPERATION;
+                goto done;
+        }
+    }
+    *result = sp[-1];
+    
+done:
+    if (stack != local_stack) {
+        free(stack);
+    }
+    return error;
+}
+
+calc_error_t bytecode_execute(const program_t* program, const symbol_table_t* symbols, double* result) {
+    return execute(program, symbols, NULL, result);
+}
+
+calc_error_t bytecode_execute_frame(const program_t* program, const frame_value_t* frame, double* result) {
+    return execute(program, NULL, frame, result);
+}
+
+// Количество строк пакета, которые каждая инструкция обрабатывает за один проход
+#define BATCH_BLOCK 256
+
+/**
+ * Источник значений переменной при пакетном вычислении
+ */
+typedef struct {
+    const double* column;  // Столбец значений или NULL, если значение берется из контекста
+    double value;          // Значение из контекста
+    bool defined;          // Найдено ли значение
+} binding_t;
+
+/**
+ * Записывает код ошибки в строки блока, в которых ошибок еще не было:
+ * как и при обходе AST, строка сохраняет первую возникшую в ней ошибку.
+ *
+ * @param lane_errors Коды ошибок строк блока
+ * @param n Количество строк блока
+ * @param error Код ошибки
+ */
+static void mark_errors(unsigned char* lane_errors, size_t n, calc_error_t error) {
+    for (size_t i = 0; i < n; i++) {
+        lane_errors[i] = lane_errors[i] ? lane_errors[i] : (unsigned char)error;
+    }
+}
+
+calc_error_t bytecode_execute_batch(const program_t* program, const symbol_table_t* symbols,
+                                    const calc_column_t* columns, size_t num_columns,
+                                    size_t count, double* results, unsigned char* errors) {
+    if (!program) return CALC_ERROR_SYNTAX;
+    if (count == 0) return CALC_SUCCESS;
+    
+    // Каждому уровню стека отводится блок значений, по одному на строку блока
+    double* stack = malloc(program->stack_depth * BATCH_BLOCK * sizeof(double));
+    binding_t* bindings = malloc((program->num_vars ? program->num_vars : 1) * sizeof(binding_t));
+    if (!stack || !bindings) {
+        free(stack);
+        free(bindings);
+        return CALC_ERROR_SYNTAX;
+    }
+    
+    // Переменные связываются со столбцами или значениями контекста один раз на пакет
+    for (size_t v = 0; v < program->num_vars; v++) {
+        const symbol_t* symbol = &symbols->symbols[program->vars[v]];
+        bindings[v].column = NULL;
+        bindings[v].value = symbol->value;
+        bindings[v].defined = symbol->defined;
+    }
+    for (size_t c = 0; c < num_columns; c++) {
+        size_t slot;
+        if (!columns[c].name || !symbol_table_find(symbols, columns[c].name, &slot)) continue;
+        for (size_t v = 0; v < program->num_vars; v++) {
+            if (program->vars[v] == slot && !bindings[v].column) {
+                bindings[v].column = columns[c].values;
+                bindings[v].defined = true;
+            }
+        }
+    }
+    
+    calc_error_t first_error = CALC_SUCCESS;
+    for (size_t base = 0; base < count; base += BATCH_BLOCK) {
+        const size_t n = count - base < BATCH_BLOCK ? count - base : BATCH_BLOCK;
+        unsigned char lane_errors[BATCH_BLOCK] = {0};
+        
+        // top - блок вершины стека, next - блок под ней (второй операнд бинарной операции
+        // лежит в top, первый и результат - в next)
+        double* top = NULL;
+        const instruction_t* end = program->code + program->length;
+        for (const instruction_t* ip = program->code; ip < end; ip++) {
+            double* restrict next = top && top != stack ? top - BATCH_BLOCK : NULL;
+            const double* restrict operand = top;
+            switch (ip->op) {
+                case OP_CONST:
+                    top = top ? top + BATCH_BLOCK : stack;
+                    for (size_t i = 0; i < n; i++) top[i] = ip->arg.number;
+                    break;
+                case OP_VAR: {
+                    const binding_t* binding = &bindings[ip->arg.var.index];
+                    top = top ? top + BATCH_BLOCK : stack;
+                    if (binding->column) {
+                        memcpy(top, binding->column + base, n * sizeof(double));
+                    } else {
+                        for (size_t i = 0; i < n; i++) top[i] = binding->value;
+                        if (!binding->defined) mark_errors(lane_errors, n, CALC_ERROR_UNDEFINED_VAR);
+                    }
+                    break;
+                }
+                case OP_NEG:
+                    for (size_t i = 0; i < n; i++) top[i] = -top[i];
+                    break;
+                case OP_FACT:
+                    for (size_t i = 0; i < n; i++) {
+                        top[i] = evaluator_factorial(top[i]);
+                        if (isnan(top[i]) && !lane_errors[i]) lane_errors[i] = CALC_ERROR_INVALID_OPERATION;
+                    }
+                    break;
+                case OP_CALL1: {
+                    const unary_op_func func = ip->arg.unary;
+                    for (size_t i = 0; i < n; i++) top[i] = func(top[i]);
+                    break;
+                }
+                case OP_CALL2: {
+                    const binary_op_func func = ip->arg.binary;
+                    for (size_t i = 0; i < n; i++) next[i] = func(next[i], operand[i]);
+                    top = next;
+                    break;
+                }
+                case OP_ADD:
+                    for (size_t i = 0; i < n; i++) next[i] = next[i] + operand[i];
+                    top = next;
+                    break;
+                case OP_SUB:
+                    for (size_t i = 0; i < n; i++) next[i] = next[i] - operand[i];
+                    top = next;
+                    break;
+                case OP_MUL:
+                    for (size_t i = 0; i < n; i++) next[i] = next[i] * operand[i];
+                    top = next;
+                    break;
+                case OP_DIV:
+                    // Деление выполняется во всех строках, а строки с нулевым делителем помечаются
+                    for (size_t i = 0; i < n; i++) {
+                        unsigned char error = operand[i] == 0 ? CALC_ERROR_INVALID_OPERATION : CALC_SUCCESS;
+                        lane_errors[i] = lane_errors[i] ? lane_errors[i] : error;
+                        next[i] = next[i] / operand[i];
+                    }
+                    top = next;
+                    break;
+                case OP_POW:
+                    for (size_t i = 0; i < n; i++) next[i] = pow(next[i], operand[i]);
+                    top = next;
+                    break;
+                case OP_INVALID:
+                    // Операнды снимаются со стека, результатом остается значение в блоке первого из них
+                    mark_errors(lane_errors, n, CALC_ERROR_INVALID_OPERATION);
+                    if (ip->arg.operands == 2) top = next;
+                    break;
+            }
+        }
+        
+        for (size_t i = 0; i < n; i++) {
+            results[base + i] = lane_errors[i] ? NAN : stack[i];
+            if (lane_errors[i] && first_error == CALC_SUCCESS) first_error = (calc_error_t)lane_errors[i];
+        }
+        if (errors) {
+            memcpy(errors + base, lane_errors, n);
+        }
+    }
+    
+    free(bindings);
+    free(stack);
+    return first_error;
+}
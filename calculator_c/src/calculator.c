@@ -1,16 +1,31 @@
 #include "calculator.h"
 #include "lexer.h"
 #include "parser.h"
-#include "evaluator.h"
+#include "optimizer.h"
+#include "bytecode.h"
+#include "symbol_table.h"
+#include "function_table.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_VARIABLES 100
+// Размер первого блока арены разбора: место под анализаторы и запас на каждый символ выражения
+#define ARENA_FIXED_SIZE 256
+#define ARENA_BYTES_PER_CHAR sizeof(ast_node_t)
 
 struct calculator_ctx_t {
-    calc_variable_t variables[MAX_VARIABLES];
-    size_t num_variables;
-    evaluator_t* evaluator;
+    symbol_table_t symbols;  // Переменные с постоянными номерами слотов
+    function_table_t functions; // Встроенные и зарегистрированные функции
+};
+
+struct calc_expression_t {
+    const calculator_ctx_t* ctx; // Контекст, к слотам переменных которого привязана программа
+    program_t* program;          // Программа стековой машины, полученная из АСД
+};
+
+struct calc_frame_t {
+    const calc_expression_t* compiled; // Выражение, переменные которого хранит кадр
+    size_t num_values;                 // Количество переменных выражения
+    frame_value_t values[];            // Значения переменных по номерам переменных программы
 };
 
 /**
@@ -21,9 +36,8 @@ struct calculator_ctx_t {
 calculator_ctx_t* calc_create(void) {
     calculator_ctx_t* ctx = malloc(sizeof(calculator_ctx_t));
     if (ctx) {
-        ctx->num_variables = 0;
-        ctx->evaluator = evaluator_create(ctx);
-        if (!ctx->evaluator) {
+        symbol_table_init(&ctx->symbols);
+        if (!function_table_init(&ctx->functions)) {
             free(ctx);
             return NULL;
         }
@@ -33,15 +47,13 @@ calculator_ctx_t* calc_create(void) {
 
 /**
  * Освобождает ресурсы, занятые контекстом калькулятора.
- * Освобождает память, выделенную для имен переменных и оценщика выражений.
+ * Освобождает память, выделенную для таблиц переменных и функций.
  * @param ctx Указатель на контекст калькулятора
  */
 void calc_destroy(calculator_ctx_t* ctx) {
     if (ctx) {
-        for (size_t i = 0; i < ctx->num_variables; i++) {
-            free(ctx->variables[i].name);
-        }
-        evaluator_destroy(ctx->evaluator);
+        symbol_table_free(&ctx->symbols);
+        function_table_free(&ctx->functions);
         free(ctx);
     }
 }
@@ -49,7 +61,7 @@ void calc_destroy(calculator_ctx_t* ctx) {
 /**
  * Устанавливает значение переменной в контексте калькулятора.
  * Если переменная уже существует, обновляет ее значение.
- * Если переменная новая, добавляет ее в список переменных.
+ * Если переменная новая, добавляет ее в таблицу переменных.
  * 
  * @param ctx Указатель на контекст калькулятора
  * @param name Имя переменной
@@ -59,24 +71,11 @@ void calc_destroy(calculator_ctx_t* ctx) {
 calc_error_t calc_set_variable(calculator_ctx_t* ctx, const char* name, double value) {
     if (!ctx || !name) return CALC_ERROR_SYNTAX;
     
-    // Проверяем, существует ли уже переменная
-    for (size_t i = 0; i < ctx->num_variables; i++) {
-        if (strcmp(ctx->variables[i].name, name) == 0) {
-            ctx->variables[i].value = value;
-            return CALC_SUCCESS;
-        }
-    }
-    
-    // Добавляем новую переменную
-    if (ctx->num_variables >= MAX_VARIABLES) {
+    size_t slot;
+    if (!symbol_table_intern(&ctx->symbols, name, &slot)) {
         return CALC_ERROR_SYNTAX;
     }
-    
-    ctx->variables[ctx->num_variables].name = strdup(name);
-    ctx->variables[ctx->num_variables].value = value;
-    ctx->num_variables++;
-    
-    return CALC_SUCCESS;
+    return calc_set_variable_by_slot(ctx, slot, value);
 }
 
 /**
@@ -92,54 +91,250 @@ calc_error_t calc_set_variable(calculator_ctx_t* ctx, const char* name, double v
 calc_error_t calc_get_variable(calculator_ctx_t* ctx, const char* name, double* value) {
     if (!ctx || !name || !value) return CALC_ERROR_SYNTAX;
     
-    for (size_t i = 0; i < ctx->num_variables; i++) {
-        if (strcmp(ctx->variables[i].name, name) == 0) {
-            *value = ctx->variables[i].value;
-            return CALC_SUCCESS;
-        }
+    size_t slot;
+    if (!symbol_table_find(&ctx->symbols, name, &slot) || !ctx->symbols.symbols[slot].defined) {
+        return CALC_ERROR_UNDEFINED_VAR;
     }
+    *value = ctx->symbols.symbols[slot].value;
+    return CALC_SUCCESS;
+}
+
+/**
+ * Возвращает номер слота переменной.
+ * Переменная, которой еще нет в контексте, добавляется без значения.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param name Имя переменной
+ * @param slot Указатель, куда будет записан номер слота
+ * @return Код ошибки: CALC_SUCCESS при успехе, иначе код ошибки
+ */
+calc_error_t calc_resolve_variable(calculator_ctx_t* ctx, const char* name, size_t* slot) {
+    if (!ctx || !name || !slot) return CALC_ERROR_SYNTAX;
+    return symbol_table_intern(&ctx->symbols, name, slot) ? CALC_SUCCESS : CALC_ERROR_SYNTAX;
+}
+
+/**
+ * Устанавливает значение переменной по номеру слота без поиска по имени.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param slot Номер слота
+ * @param value Значение переменной
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR для несуществующего слота
+ */
+calc_error_t calc_set_variable_by_slot(calculator_ctx_t* ctx, size_t slot, double value) {
+    if (!ctx) return CALC_ERROR_SYNTAX;
+    if (slot >= ctx->symbols.count) return CALC_ERROR_UNDEFINED_VAR;
     
-    return CALC_ERROR_UNDEFINED_VAR;
+    ctx->symbols.symbols[slot].value = value;
+    ctx->symbols.symbols[slot].defined = true;
+    return CALC_SUCCESS;
 }
 
 /**
- * Вычисляет значение выражения.
- * Выполняет лексический анализ, синтаксический разбор и вычисление выражения.
+ * Компилирует выражение.
+ * Выполняет лексический анализ и синтаксический разбор один раз, сворачивает
+ * константные подвыражения и переводит построенное АСД в плоский массив
+ * инструкций стековой машины. Переменные
+ * выражения при этом связываются со слотами таблицы переменных контекста,
+ * а вызовы функций - с функциями, зарегистрированными к моменту компиляции.
  * 
  * @param ctx Указатель на контекст калькулятора
- * @param expression Строка с выражением для вычисления
- * @param result Указатель, куда будет записан результат вычисления
+ * @param expression Строка с выражением
+ * @param compiled Указатель, куда будет записано скомпилированное выражение
  * @return Код ошибки: CALC_SUCCESS при успехе, иначе код ошибки
  */
-calc_error_t calc_evaluate(calculator_ctx_t* ctx, const char* expression, double* result) {
-    if (!ctx || !expression || !result) return CALC_ERROR_SYNTAX;
+calc_error_t calc_compile(calculator_ctx_t* ctx, const char* expression, calc_expression_t** compiled) {
+    if (!ctx || !expression || !compiled) return CALC_ERROR_SYNTAX;
+    *compiled = NULL;
     
-    // Создаем лексический анализатор
-    lexer_t* lexer = lexer_create(expression);
-    if (!lexer) return CALC_ERROR_SYNTAX;
+    // Анализаторы, узлы АСД и имена размещаются в одной арене. Каждый символ выражения
+    // дает не больше одного узла, поэтому первого блока обычно хватает на весь разбор
+    arena_t* arena = arena_create(ARENA_FIXED_SIZE + strlen(expression) * ARENA_BYTES_PER_CHAR);
+    if (!arena) return CALC_ERROR_SYNTAX;
     
-    // Создаем синтаксический анализатор
-    parser_t* parser = parser_create(lexer);
-    if (!parser) {
-        lexer_destroy(lexer);
-        return CALC_ERROR_SYNTAX;
-    }
+    // Создаем лексический и синтаксический анализаторы
+    lexer_t* lexer = lexer_create(expression, arena);
+    parser_t* parser = lexer ? parser_create(lexer, arena, &ctx->functions) : NULL;
     
     // Разбираем выражение в АСД (абстрактное синтаксическое дерево)
-    ast_node_t* ast = parser_parse(parser);
-    if (!ast) {
-        parser_destroy(parser);
-        lexer_destroy(lexer);
+    ast_node_t* ast = parser ? parser_parse(parser) : NULL;
+    
+    // Сворачиваем константы, чтобы они не вычислялись заново при каждом вычислении
+    ast = optimizer_simplify(ast);
+    
+    // АСД нужно только для построения программы и освобождается вместе с ареной
+    program_t* program = ast ? bytecode_compile(ast, &ctx->symbols) : NULL;
+    arena_destroy(arena);
+    if (!program) return CALC_ERROR_SYNTAX;
+    
+    calc_expression_t* expr = malloc(sizeof(calc_expression_t));
+    if (!expr) {
+        bytecode_destroy(program);
         return CALC_ERROR_SYNTAX;
     }
+    expr->ctx = ctx;
+    expr->program = program;
+    *compiled = expr;
+    return CALC_SUCCESS;
+}
+
+/**
+ * Вычисляет скомпилированное выражение.
+ * Разбор не повторяется: стековая машина выполняет инструкции подряд.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param compiled Скомпилированное выражение
+ * @param result Указатель, куда будет записан результат вычисления
+ * @return Код ошибки: CALC_SUCCESS при успехе, иначе код ошибки
+ */
+calc_error_t calc_eval_compiled(calculator_ctx_t* ctx, const calc_expression_t* compiled, double* result) {
+    if (!ctx || !compiled || !result) return CALC_ERROR_SYNTAX;
+    if (compiled->ctx != ctx) return CALC_ERROR_INVALID_OPERATION;
+    return bytecode_execute(compiled->program, &ctx->symbols, result);
+}
+
+/**
+ * Вычисляет скомпилированное выражение для пакета строк.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param compiled Скомпилированное выражение
+ * @param columns Столбцы значений переменных
+ * @param num_columns Количество столбцов
+ * @param count Количество строк
+ * @param results Массив результатов
+ * @param errors Маска кодов ошибок по строкам или NULL
+ * @return Код ошибки: CALC_SUCCESS, если все строки вычислены успешно
+ */
+calc_error_t calc_eval_batch(calculator_ctx_t* ctx, const calc_expression_t* compiled,
+                             const calc_column_t* columns, size_t num_columns,
+                             size_t count, double* results, unsigned char* errors) {
+    if (!ctx || !compiled || (num_columns && !columns) || (count && !results)) return CALC_ERROR_SYNTAX;
+    if (compiled->ctx != ctx) return CALC_ERROR_INVALID_OPERATION;
+    return bytecode_execute_batch(compiled->program, &ctx->symbols, columns, num_columns, count, results, errors);
+}
+
+/**
+ * Освобождает скомпилированное выражение вместе с его программой.
+ * 
+ * @param compiled Скомпилированное выражение
+ */
+void calc_free_compiled(calc_expression_t* compiled) {
+    if (compiled) {
+        bytecode_destroy(compiled->program);
+        free(compiled);
+    }
+}
+
+/**
+ * Создает кадр вычисления со значениями переменных контекста выражения.
+ * Кадр и его значения размещаются одним выделением памяти.
+ * 
+ * @param compiled Скомпилированное выражение
+ * @return Указатель на созданный кадр или NULL при ошибке
+ */
+calc_frame_t* calc_frame_create(const calc_expression_t* compiled) {
+    if (!compiled) return NULL;
+    
+    const size_t num_values = bytecode_num_vars(compiled->program);
+    calc_frame_t* frame = malloc(sizeof(calc_frame_t) + num_values * sizeof(frame_value_t));
+    if (frame) {
+        frame->compiled = compiled;
+        frame->num_values = num_values;
+        bytecode_bind_frame(compiled->program, &compiled->ctx->symbols, frame->values);
+    }
+    return frame;
+}
+
+/**
+ * Освобождает кадр вычисления.
+ * 
+ * @param frame Указатель на кадр
+ */
+void calc_frame_destroy(calc_frame_t* frame) {
+    free(frame);
+}
+
+/**
+ * Возвращает номер переменной в кадре.
+ * 
+ * @param frame Указатель на кадр
+ * @param name Имя переменной
+ * @param index Указатель, куда будет записан номер переменной
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR если выражение не использует переменную
+ */
+calc_error_t calc_frame_find_variable(const calc_frame_t* frame, const char* name, size_t* index) {
+    if (!frame || !name || !index) return CALC_ERROR_SYNTAX;
+    return bytecode_find_var(frame->compiled->program, name, index) ? CALC_SUCCESS : CALC_ERROR_UNDEFINED_VAR;
+}
+
+/**
+ * Устанавливает значение переменной кадра по номеру.
+ * 
+ * @param frame Указатель на кадр
+ * @param index Номер переменной
+ * @param value Значение переменной
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR для несуществующего номера
+ */
+calc_error_t calc_frame_set(calc_frame_t* frame, size_t index, double value) {
+    if (!frame) return CALC_ERROR_SYNTAX;
+    if (index >= frame->num_values) return CALC_ERROR_UNDEFINED_VAR;
+    
+    frame->values[index].value = value;
+    frame->values[index].defined = true;
+    return CALC_SUCCESS;
+}
+
+/**
+ * Устанавливает значение переменной кадра по имени.
+ * 
+ * @param frame Указатель на кадр
+ * @param name Имя переменной
+ * @param value Значение переменной
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_UNDEFINED_VAR если выражение не использует переменную
+ */
+calc_error_t calc_frame_set_variable(calc_frame_t* frame, const char* name, double value) {
+    size_t index;
+    calc_error_t error = calc_frame_find_variable(frame, name, &index);
+    if (error != CALC_SUCCESS) return error;
+    return calc_frame_set(frame, index, value);
+}
+
+/**
+ * Вычисляет скомпилированное выражение в кадре.
+ * Ни выражение, ни контекст не изменяются, поэтому потоки со своими кадрами
+ * вычисляют одно выражение одновременно без синхронизации.
+ * 
+ * @param frame Указатель на кадр
+ * @param result Указатель, куда будет записан результат вычисления
+ * @return Код ошибки: CALC_SUCCESS при успехе, иначе код ошибки
+ */
+calc_error_t calc_eval_frame(const calc_frame_t* frame, double* result) {
+    if (!frame || !result) return CALC_ERROR_SYNTAX;
+    return bytecode_execute_frame(frame->compiled->program, frame->values, result);
+}
+
+/**
+ * Вычисляет значение выражения.
+ * Компилирует выражение, вычисляет его и сразу освобождает. Для выражений,
+ * вычисляемых многократно, выгоднее calc_compile и calc_eval_compiled.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param expression Строка с выражением для вычисления
+ * @param result Указатель, куда будет записан результат вычисления
+ * @return Код ошибки: CALC_SUCCESS при успехе, иначе код ошибки
+ */
+calc_error_t calc_evaluate(calculator_ctx_t* ctx, const char* expression, double* result) {
+    if (!ctx || !expression || !result) return CALC_ERROR_SYNTAX;
     
-    // Вычисляем выражение с помощью оценщика
-    calc_error_t error = evaluator_evaluate(ctx->evaluator, ast, result);
+    calc_expression_t* compiled;
+    calc_error_t error = calc_compile(ctx, expression, &compiled);
+    if (error != CALC_SUCCESS) return error;
+    
+    // Вычисляем выражение
+    error = calc_eval_compiled(ctx, compiled, result);
     
     // Освобождаем ресурсы
-    ast_destroy(ast);
-    parser_destroy(parser);
-    lexer_destroy(lexer);
+    calc_free_compiled(compiled);
     
     return error;
 }
@@ -158,4 +353,34 @@ const char* calc_get_error_message(calc_error_t error) {
         case CALC_ERROR_INVALID_OPERATION: return "Недопустимая операция";
         default: return "Неизвестная ошибка";
     }
+}
+
+/**
+ * Регистрирует унарную операцию (функцию одного аргумента).
+ * Функция с тем же именем заменяется; уже скомпилированные выражения
+ * продолжают вызывать функцию, зарегистрированную на момент компиляции.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param name Имя функции (идентификатор)
+ * @param func Указатель на функцию, реализующую операцию
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_SYNTAX для недопустимого имени
+ */
+calc_error_t calc_register_unary_op(calculator_ctx_t* ctx, const char* name, unary_op_func func) {
+    if (!ctx || !name || !func) return CALC_ERROR_SYNTAX;
+    return function_table_add_unary(&ctx->functions, name, func) ? CALC_SUCCESS : CALC_ERROR_SYNTAX;
+}
+
+/**
+ * Регистрирует бинарную операцию (функцию двух аргументов, вызываемую как name(a, b)).
+ * Функция с тем же именем заменяется; уже скомпилированные выражения
+ * продолжают вызывать функцию, зарегистрированную на момент компиляции.
+ * 
+ * @param ctx Указатель на контекст калькулятора
+ * @param name Имя функции (идентификатор)
+ * @param func Указатель на функцию, реализующую операцию
+ * @return Код ошибки: CALC_SUCCESS при успехе, CALC_ERROR_SYNTAX для недопустимого имени
+ */
+calc_error_t calc_register_binary_op(calculator_ctx_t* ctx, const char* name, binary_op_func func) {
+    if (!ctx || !name || !func) return CALC_ERROR_SYNTAX;
+    return function_table_add_binary(&ctx->functions, name, func) ? CALC_SUCCESS : CALC_ERROR_SYNTAX;
 }
\ No newline at end of file
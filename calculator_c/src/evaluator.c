@@ -3,8 +3,6 @@
 #include <string.h>
 #include <math.h>
 
-#define PI 3.1415926535
-
 struct evaluator_t {
     calculator_ctx_t* calc_ctx;
 };
@@ -21,13 +19,13 @@ void evaluator_destroy(evaluator_t* eval) {
     free(eval);
 }
 
-static double factorial(double n) {
+double evaluator_factorial(double n) {
     // Проверяем, является ли число целым и неотрицательным
     if (n < 0 || n != floor(n)) {
         return NAN;  // Not-a-Number для обозначения ошибки
     }
     if (n == 0 || n == 1) return 1;
-    return n * factorial(n - 1);
+    return n * evaluator_factorial(n - 1);
 }
 
 calc_error_t evaluator_evaluate(evaluator_t* eval, ast_node_t* node, double* result) {
@@ -41,7 +39,7 @@ calc_error_t evaluator_evaluate(evaluator_t* eval, ast_node_t* node, double* res
         case AST_VARIABLE: {
             double value;
             if (strcmp(node->value.variable, "PI") == 0) {
-                *result = PI;
+                *result = CALC_PI;
                 return CALC_SUCCESS;
             }
             if (calc_get_variable(eval->calc_ctx, node->value.variable, &value) != CALC_SUCCESS) {
@@ -56,20 +54,16 @@ calc_error_t evaluator_evaluate(evaluator_t* eval, ast_node_t* node, double* res
             calc_error_t err = evaluator_evaluate(eval, node->value.unary_op.operand, &operand);
             if (err != CALC_SUCCESS) return err;
             
-            if (strcmp(node->value.unary_op.oper, "-") == 0) {
-                *result = -operand;
-            } else if (strcmp(node->value.unary_op.oper, "sin") == 0) {
-                *result = sin(operand);
-            } else if (strcmp(node->value.unary_op.oper, "cos") == 0) {
-                *result = cos(operand);
-            } else if (strcmp(node->value.unary_op.oper, "!") == 0) {
-                *result = factorial(operand);
-                // Проверяем результат factorial на NaN
-                if (isnan(*result)) {
-                    return CALC_ERROR_INVALID_OPERATION;
-                }
-            } else {
-                return CALC_ERROR_INVALID_OPERATION;
+            switch (node->value.unary_op.oper) {
+                case '-': *result = -operand; break;
+                case '!':
+                    *result = evaluator_factorial(operand);
+                    // Проверяем результат factorial на NaN
+                    if (isnan(*result)) {
+                        return CALC_ERROR_INVALID_OPERATION;
+                    }
+                    break;
+                default: return CALC_ERROR_INVALID_OPERATION;
             }
             return CALC_SUCCESS;
         }
@@ -95,6 +89,21 @@ calc_error_t evaluator_evaluate(evaluator_t* eval, ast_node_t* node, double* res
             }
             return CALC_SUCCESS;
         }
+        
+        case AST_CALL: {
+            double args[FUNCTION_MAX_ARITY];
+            for (size_t i = 0; i < node->value.call.num_args; i++) {
+                calc_error_t err = evaluator_evaluate(eval, node->value.call.args[i], &args[i]);
+                if (err != CALC_SUCCESS) return err;
+            }
+            
+            // Функция уже разрешена при разборе: вызов идет по указателю без поиска по имени
+            const function_t* function = node->value.call.function;
+            if (!function) return CALC_ERROR_INVALID_OPERATION;
+            *result = function->arity == 1 ? function->func.unary(args[0])
+                                           : function->func.binary(args[0], args[1]);
+            return CALC_SUCCESS;
+        }
     }
     return CALC_ERROR_SYNTAX;
 }
\ No newline at end of file
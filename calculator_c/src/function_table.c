@@ -0,0 +1,108 @@
+#include "function_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+/**
+ * Проверяет, что имя - идентификатор, который лексический анализатор
+ * распознает в выражении.
+ *
+ * @param name Имя функции
+ * @return true, если имя допустимо
+ */
+static bool is_identifier(const char* name) {
+    if (!isalpha((unsigned char)name[0]) && name[0] != '_') return false;
+    for (const char* c = name + 1; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') return false;
+    }
+    return true;
+}
+
+/**
+ * Ищет номер записи функции по имени и количеству аргументов.
+ * Поиск выполняется только при разборе, поэтому линейного просмотра достаточно.
+ *
+ * @param table Указатель на таблицу
+ * @param name Имя функции
+ * @param arity Количество аргументов
+ * @return Номер записи или количество функций, если такой функции нет
+ */
+static size_t find_index(const function_table_t* table, const char* name, size_t arity) {
+    size_t i = 0;
+    while (i < table->count &&
+           (table->functions[i].arity != arity || strcmp(table->functions[i].name, name) != 0)) {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Возвращает запись функции для регистрации: существующую с тем же именем
+ * и количеством аргументов или новую в конце таблицы.
+ *
+ * @param table Указатель на таблицу
+ * @param name Имя функции
+ * @param arity Количество аргументов
+ * @return Указатель на запись или NULL для недопустимого имени и при ошибке выделения памяти
+ */
+static function_t* add_entry(function_table_t* table, const char* name, size_t arity) {
+    if (!is_identifier(name)) return NULL;
+    
+    size_t index = find_index(table, name, arity);
+    if (index < table->count) return &table->functions[index];
+    
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity ? 2 * table->capacity : 8;
+        function_t* functions = realloc(table->functions, capacity * sizeof(function_t));
+        if (!functions) return NULL;
+        table->functions = functions;
+        table->capacity = capacity;
+    }
+    
+    char* copy = strdup(name);
+    if (!copy) return NULL;
+    
+    function_t* function = &table->functions[table->count++];
+    function->name = copy;
+    function->arity = arity;
+    return function;
+}
+
+bool function_table_init(function_table_t* table) {
+    memset(table, 0, sizeof(*table));
+    
+    // Встроенные функции хранятся в той же таблице, что и пользовательские
+    if (!function_table_add_unary(table, "sin", sin) || !function_table_add_unary(table, "cos", cos)) {
+        function_table_free(table);
+        return false;
+    }
+    return true;
+}
+
+void function_table_free(function_table_t* table) {
+    for (size_t i = 0; i < table->count; i++) {
+        free(table->functions[i].name);
+    }
+    free(table->functions);
+    memset(table, 0, sizeof(*table));
+}
+
+const function_t* function_table_find(const function_table_t* table, const char* name, size_t arity) {
+    size_t index = find_index(table, name, arity);
+    return index < table->count ? &table->functions[index] : NULL;
+}
+
+bool function_table_add_unary(function_table_t* table, const char* name, unary_op_func func) {
+    function_t* function = add_entry(table, name, 1);
+    if (!function) return false;
+    function->func.unary = func;
+    return true;
+}
+
+bool function_table_add_binary(function_table_t* table, const char* name, binary_op_func func) {
+    function_t* function = add_entry(table, name, 2);
+    if (!function) return false;
+    function->func.binary = func;
+    return true;
+}
@@ -0,0 +1,186 @@
+#include "optimizer.h"
+#include "evaluator.h"
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+/**
+ * Превращает узел в числовую константу.
+ *
+ * @param node Узел AST
+ * @param value Значение константы
+ * @return Тот же узел
+ */
+static ast_node_t* make_number(ast_node_t* node, double value) {
+    node->type = AST_NUMBER;
+    node->value.number = value;
+    return node;
+}
+
+/**
+ * Проверяет, что узел - константа с заданным значением, включая знак нуля.
+ *
+ * @param node Узел AST
+ * @param value Ожидаемое значение
+ * @return true, если узел - константа, побитово равная value
+ */
+static bool is_constant(const ast_node_t* node, double value) {
+    return node->type == AST_NUMBER && node->value.number == value &&
+           signbit(node->value.number) == signbit(value);
+}
+
+/**
+ * Вычисляет унарную операцию над константой так же, как вычислитель.
+ *
+ * @param oper Символ операции
+ * @param operand Значение операнда
+ * @param result Указатель для записи результата
+ * @return true, если операция известна и выполняется без ошибки
+ */
+static bool fold_unary(char oper, double operand, double* result) {
+    switch (oper) {
+        case '-': *result = -operand; return true;
+        case '!':
+            *result = evaluator_factorial(operand);
+            return !isnan(*result);
+        default: return false;
+    }
+}
+
+/**
+ * Вычисляет бинарную операцию над константами так же, как вычислитель.
+ *
+ * @param oper Символ операции
+ * @param left Значение левого операнда
+ * @param right Значение правого операнда
+ * @param result Указатель для записи результата
+ * @return true, если операция известна и выполняется без ошибки
+ */
+static bool fold_binary(char oper, double left, double right, double* result) {
+    switch (oper) {
+        case '+': *result = left + right; return true;
+        case '-': *result = left - right; return true;
+        case '*': *result = left * right; return true;
+        case '/':
+            if (right == 0) return false;
+            *result = left / right;
+            return true;
+        case '^': *result = pow(left, right); return true;
+        default: return false;
+    }
+}
+
+/**
+ * Упрощает узел унарной операции после упрощения операнда.
+ *
+ * @param node Узел унарной операции
+ * @return Упрощенный узел
+ */
+static ast_node_t* simplify_unary(ast_node_t* node) {
+    ast_node_t* operand = optimizer_simplify(node->value.unary_op.operand);
+    node->value.unary_op.operand = operand;
+    const char oper = node->value.unary_op.oper;
+    
+    double value;
+    if (operand->type == AST_NUMBER && fold_unary(oper, operand->value.number, &value)) {
+        return make_number(node, value);
+    }
+    
+    // Двойное отрицание только дважды меняет знаковый бит
+    if (oper == '-' && operand->type == AST_UNARY_OP && operand->value.unary_op.oper == '-') {
+        return operand->value.unary_op.operand;
+    }
+    return node;
+}
+
+/**
+ * Упрощает узел бинарной операции после упрощения операндов.
+ * Тождества применяются только там, где результат совпадает побитово для любого
+ * значения операнда, включая NaN, бесконечности и нули со знаком.
+ *
+ * @param node Узел бинарной операции
+ * @return Упрощенный узел
+ */
+static ast_node_t* simplify_binary(ast_node_t* node) {
+    ast_node_t* left = optimizer_simplify(node->value.binary_op.left);
+    ast_node_t* right = optimizer_simplify(node->value.binary_op.right);
+    node->value.binary_op.left = left;
+    node->value.binary_op.right = right;
+    
+    double value;
+    if (left->type == AST_NUMBER && right->type == AST_NUMBER &&
+        fold_binary(node->value.binary_op.oper, left->value.number, right->value.number, &value)) {
+        return make_number(node, value);
+    }
+    
+    switch (node->value.binary_op.oper) {
+        case '*':
+            if (is_constant(right, 1.0)) return left;
+            if (is_constant(left, 1.0)) return right;
+            break;
+        case '/':
+        case '^':
+            if (is_constant(right, 1.0)) return left;
+            break;
+        case '-':
+            if (is_constant(right, 0.0)) return left;
+            break;
+        case '+':
+            // x + 0 для x = -0 дает +0, а x + (-0) равно x всегда
+            if (is_constant(right, -0.0)) return left;
+            if (is_constant(left, -0.0)) return right;
+            break;
+    }
+    return node;
+}
+
+/**
+ * Упрощает аргументы вызова и вычисляет вызов известной функции, если все
+ * аргументы - константы. Функции зависят только от аргументов, поэтому
+ * результат совпадает с результатом вызова при вычислении.
+ *
+ * @param node Узел вызова функции
+ * @return Упрощенный узел
+ */
+static ast_node_t* simplify_call(ast_node_t* node) {
+    bool constant = true;
+    for (size_t i = 0; i < node->value.call.num_args; i++) {
+        ast_node_t* arg = optimizer_simplify(node->value.call.args[i]);
+        node->value.call.args[i] = arg;
+        constant = constant && arg->type == AST_NUMBER;
+    }
+    
+    const function_t* function = node->value.call.function;
+    if (!constant || !function) return node;
+    
+    ast_node_t* const* args = node->value.call.args;
+    if (function->arity == 1) {
+        return make_number(node, function->func.unary(args[0]->value.number));
+    }
+    return make_number(node, function->func.binary(args[0]->value.number, args[1]->value.number));
+}
+
+ast_node_t* optimizer_simplify(ast_node_t* node) {
+    if (!node) return NULL;
+    
+    switch (node->type) {
+        case AST_NUMBER:
+            return node;
+        
+        case AST_VARIABLE:
+            if (strcmp(node->value.variable, "PI") == 0) {
+                return make_number(node, CALC_PI);
+            }
+            return node;
+        
+        case AST_UNARY_OP:
+            return simplify_unary(node);
+        
+        case AST_BINARY_OP:
+            return simplify_binary(node);
+        
+        case AST_CALL:
+            return simplify_call(node);
+    }
+    return node;
+}
@@ -4,7 +4,9 @@
 #include <stdbool.h>
 
 struct parser_t {
+    arena_t* arena;             // Арена для узлов AST
     lexer_t* lexer;             // Указатель на лексический анализатор
+    const function_table_t* functions; // Таблица функций для разрешения вызовов
     token_t current_token;      // Текущий обрабатываемый токен
     bool has_error;             // Флаг наличия ошибки
     const char* error_message;  // Сообщение об ошибке
@@ -31,12 +33,16 @@ static int get_operator_precedence(char op) {
  * Создает синтаксический анализатор на основе лексического.
  * 
  * @param lexer Указатель на лексический анализатор
+ * @param arena Арена, в которой размещаются анализатор и узлы AST
+ * @param functions Таблица функций
  * @return Указатель на созданный синтаксический анализатор или NULL при ошибке
  */
-parser_t* parser_create(lexer_t* lexer) {
-    parser_t* parser = malloc(sizeof(parser_t));
+parser_t* parser_create(lexer_t* lexer, arena_t* arena, const function_table_t* functions) {
+    parser_t* parser = arena_alloc(arena, sizeof(parser_t));
     if (parser) {
+        parser->arena = arena;
         parser->lexer = lexer;
+        parser->functions = functions;
         parser->has_error = false;
         parser->error_message = NULL;
         parser->current_token = lexer_next_token(lexer);
@@ -44,25 +50,12 @@ parser_t* parser_create(lexer_t* lexer) {
     return parser;
 }
 
-/**
- * Освобождает ресурсы, занятые синтаксическим анализатором.
- * 
- * @param parser Указатель на синтаксический анализатор
- */
-void parser_destroy(parser_t* parser) {
-    if (parser) {
-        token_destroy(&parser->current_token);
-        free(parser);
-    }
-}
-
 /**
  * Потребляет текущий токен и получает следующий.
  * 
  * @param parser Указатель на синтаксический анализатор
  */
 static void advance(parser_t* parser) {
-    token_destroy(&parser->current_token);
     parser->current_token = lexer_next_token(parser->lexer);
 }
 
@@ -78,52 +71,59 @@ static ast_node_t* parse_primary(parser_t* parser) {
     switch (token.type) {
         case TOKEN_NUMBER: {
             advance(parser);
-            ast_node_t* num = ast_create_number(token.value.number);
+            ast_node_t* num = ast_create_number(parser->arena, token.value.number);
             
             // Проверяем наличие постфиксного факториала
             if (parser->current_token.type == TOKEN_OPERATOR && 
                 parser->current_token.value.oper == '!') {
                 advance(parser);
-                return ast_create_unary_op("!", num);
+                return ast_create_unary_op(parser->arena, '!', num);
             }
             return num;
         }
         
         case TOKEN_IDENTIFIER: {
-            char* name = strdup(token.value.identifier);
+            // Имя размещено в арене и остается действительным после перехода к следующему токену
+            const char* name = token.value.identifier;
             advance(parser);
             
             // Проверяем, является ли идентификатор функцией
             if (parser->current_token.type == TOKEN_LPAREN) {
                 advance(parser);
-                ast_node_t* arg = parse_expression(parser);
-                if (!arg) {
-                    free(name);
-                    return NULL;
+                ast_node_t* args[FUNCTION_MAX_ARITY];
+                size_t num_args = 0;
+                for (;;) {
+                    if (num_args == FUNCTION_MAX_ARITY) {
+                        parser->has_error = true;
+                        parser->error_message = "Слишком много аргументов функции";
+                        return NULL;
+                    }
+                    args[num_args] = parse_expression(parser);
+                    if (!args[num_args++]) return NULL;
+                    
+                    if (parser->current_token.type != TOKEN_COMMA) break;
+                    advance(parser);
                 }
                 
                 if (parser->current_token.type != TOKEN_RPAREN) {
                     parser->has_error = true;
                     parser->error_message = "Ожидается закрывающая скобка";
-                    free(name);
-                    ast_destroy(arg);
                     return NULL;
                 }
                 advance(parser);
                 
-                ast_node_t* func = ast_create_unary_op(name, arg);
-                free(name);
-                return func;
+                // Имя разрешается в функцию один раз; неизвестная функция дает ошибку при вычислении
+                const function_t* function = function_table_find(parser->functions, name, num_args);
+                return ast_create_call(parser->arena, name, function, args, num_args);
             }
             
-            ast_node_t* var = ast_create_variable(name);
-            free(name);
+            ast_node_t* var = ast_create_variable(parser->arena, name);
             
             // Проверяем наличие постфиксного факториала
             if (parser->current_token.type == TOKEN_OPERATOR && 
                 parser->current_token.value.oper == '!') {
                 advance(parser);
-                return ast_create_unary_op("!", var);
+                return ast_create_unary_op(parser->arena, '!', var);
             }
             return var;
         }
@@ -146,7 +146,6 @@ static ast_node_t* parse_primary(parser_t* parser) {
             if (parser->current_token.type != expected_close) {
                 parser->has_error = true;
                 parser->error_message = "Несогласованные скобки";
-                ast_destroy(expr);
                 return NULL;
             }
             advance(parser);
@@ -155,7 +154,7 @@ static ast_node_t* parse_primary(parser_t* parser) {
             if (parser->current_token.type == TOKEN_OPERATOR && 
                 parser->current_token.value.oper == '!') {
                 advance(parser);
-                return ast_create_unary_op("!", expr);
+                return ast_create_unary_op(parser->arena, '!', expr);
             }
             return expr;
         }
@@ -182,7 +181,7 @@ static ast_node_t* parse_unary(parser_t* parser) {
             if (!operand) return NULL;
             
             if (op == '+') return operand;  // Унарный плюс можно игнорировать
-            return ast_create_unary_op("-", operand);
+            return ast_create_unary_op(parser->arena, '-', operand);
         }
     }
     
@@ -215,19 +214,16 @@ static ast_node_t* parse_binary(parser_t* parser, int precedence) {
             parser->current_token.value.oper != '-') {    // Разрешаем унарный минус после оператора
             parser->has_error = true;
             parser->error_message = "Последовательные операторы не допускаются";
-            ast_destroy(left);
             return NULL;
         }
         
         // Разбираем правую часть выражения с повышенным минимальным приоритетом
         ast_node_t* right = parse_binary(parser, op_precedence);
-        if (!right) {
-            ast_destroy(left);
-            return NULL;
-        }
+        if (!right) return NULL;
         
         // Создаем узел бинарной операции
-        left = ast_create_binary_op(op, left, right);
+        left = ast_create_binary_op(parser->arena, op, left, right);
+        if (!left) return NULL;
     }
     
     return left;
@@ -256,7 +252,6 @@ ast_node_t* parser_parse(parser_t* parser) {
     if (result && parser->current_token.type != TOKEN_EOF) {
         parser->has_error = true;
         parser->error_message = "Неожиданные токены после выражения";
-        ast_destroy(result);
         return NULL;
     }
     
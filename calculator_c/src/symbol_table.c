@@ -0,0 +1,111 @@
+#include "symbol_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Начальный размер хеш-индекса; индекс заполняется не более чем наполовину
+#define INITIAL_INDEX_SIZE 16
+
+/**
+ * Вычисляет хеш имени (FNV-1a).
+ *
+ * @param name Имя переменной
+ * @return Хеш имени
+ */
+static size_t hash_name(const char* name) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const unsigned char* c = (const unsigned char*)name; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ull;
+    }
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/**
+ * Помещает слот в хеш-индекс. Свободная ячейка ищется линейным пробированием.
+ *
+ * @param index Хеш-индекс
+ * @param index_size Размер индекса (степень двойки)
+ * @param name Имя переменной слота
+ * @param slot Номер слота
+ */
+static void index_insert(size_t* index, size_t index_size, const char* name, size_t slot) {
+    size_t cell = hash_name(name) & (index_size - 1);
+    while (index[cell] != 0) {
+        cell = (cell + 1) & (index_size - 1);
+    }
+    index[cell] = slot + 1;
+}
+
+/**
+ * Увеличивает хеш-индекс вдвое и заново размещает в нем все слоты.
+ *
+ * @param table Указатель на таблицу
+ * @return true при успехе, false при ошибке выделения памяти
+ */
+static bool grow_index(symbol_table_t* table) {
+    size_t size = table->index_size ? 2 * table->index_size : INITIAL_INDEX_SIZE;
+    size_t* index = calloc(size, sizeof(size_t));
+    if (!index) return false;
+    
+    for (size_t slot = 0; slot < table->count; slot++) {
+        index_insert(index, size, table->symbols[slot].name, slot);
+    }
+    free(table->index);
+    table->index = index;
+    table->index_size = size;
+    return true;
+}
+
+void symbol_table_init(symbol_table_t* table) {
+    memset(table, 0, sizeof(*table));
+}
+
+void symbol_table_free(symbol_table_t* table) {
+    for (size_t i = 0; i < table->count; i++) {
+        free(table->symbols[i].name);
+    }
+    free(table->symbols);
+    free(table->index);
+    symbol_table_init(table);
+}
+
+bool symbol_table_find(const symbol_table_t* table, const char* name, size_t* slot) {
+    if (table->index_size == 0) return false;
+    
+    size_t cell = hash_name(name) & (table->index_size - 1);
+    while (table->index[cell] != 0) {
+        size_t candidate = table->index[cell] - 1;
+        if (strcmp(table->symbols[candidate].name, name) == 0) {
+            *slot = candidate;
+            return true;
+        }
+        cell = (cell + 1) & (table->index_size - 1);
+    }
+    return false;
+}
+
+bool symbol_table_intern(symbol_table_t* table, const char* name, size_t* slot) {
+    if (symbol_table_find(table, name, slot)) return true;
+    
+    // Индекс расширяется заранее, чтобы в нем всегда оставались свободные ячейки
+    if (2 * (table->count + 1) > table->index_size && !grow_index(table)) return false;
+    
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity ? 2 * table->capacity : INITIAL_INDEX_SIZE / 2;
+        symbol_t* symbols = realloc(table->symbols, capacity * sizeof(symbol_t));
+        if (!symbols) return false;
+        table->symbols = symbols;
+        table->capacity = capacity;
+    }
+    
+    char* copy = strdup(name);
+    if (!copy) return false;
+    
+    symbol_t* symbol = &table->symbols[table->count];
+    symbol->name = copy;
+    symbol->value = 0;
+    symbol->defined = false;
+    index_insert(table->index, table->index_size, copy, table->count);
+    *slot = table->count++;
+    return true;
+}
@@ -1,5 +1,6 @@
 #include "calculator.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
@@ -128,6 +129,353 @@ static void test_complex_expressions(void) {
     printf("Complex expression tests passed\n");
 }
 
+static void test_compiled_expressions(void) {
+    calculator_ctx_t* calc = calc_create();
+    calc_expression_t* expr;
+    double result;
+    
+    assert(calc_compile(calc, "x * x + 2 * y", &expr) == CALC_SUCCESS);
+    
+    // Одно скомпилированное выражение вычисляется с разными значениями переменных
+    for (int i = 0; i < 10; i++) {
+        assert(calc_set_variable(calc, "x", i) == CALC_SUCCESS);
+        assert(calc_set_variable(calc, "y", 0.5 * i) == CALC_SUCCESS);
+        assert(calc_eval_compiled(calc, expr, &result) == CALC_SUCCESS);
+        assert(double_eq(result, i * i + i));
+    }
+    calc_free_compiled(expr);
+    
+    // Ошибки разбора обнаруживаются при компиляции, ошибки вычисления - при вычислении
+    assert(calc_compile(calc, "1 + + 2", &expr) == CALC_ERROR_SYNTAX);
+    assert(expr == NULL);
+    
+    assert(calc_compile(calc, "1 / z", &expr) == CALC_SUCCESS);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_set_variable(calc, "z", 0.0) == CALC_SUCCESS);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_set_variable(calc, "z", 4.0) == CALC_SUCCESS);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 0.25));
+    calc_free_compiled(expr);
+    
+    calc_free_compiled(NULL);
+    
+    calc_destroy(calc);
+    printf("Compiled expression tests passed\n");
+}
+
+static void test_compiled_error_order(void) {
+    calculator_ctx_t* calc = calc_create();
+    double result;
+    
+    // Ошибки возникают в порядке вычисления: сначала операнды слева направо, затем операция
+    assert(calc_evaluate(calc, "tan(1)", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "tan(z)", &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_evaluate(calc, "z / 0", &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_evaluate(calc, "1 / 0 + z", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "(2 - 3)! * z", &result) == CALC_ERROR_INVALID_OPERATION);
+    
+    // Глубоко вложенное выражение не помещается в локальный стек вычисления
+    char expression[1024] = "";
+    for (int i = 0; i < 100; i++) strcat(expression, "(1 + ");
+    strcat(expression, "0");
+    for (int i = 0; i < 100; i++) strcat(expression, ")");
+    assert(calc_evaluate(calc, expression, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 100.0));
+    
+    calc_destroy(calc);
+    printf("Compiled error order tests passed\n");
+}
+
+static void test_batch_evaluation(void) {
+    calculator_ctx_t* calc = calc_create();
+    calc_expression_t* expr;
+    double result;
+    
+    // Размер пакета не кратен размеру блока вычисления
+    enum { COUNT = 1000 };
+    static double xs[COUNT], ys[COUNT], results[COUNT];
+    static unsigned char errors[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        xs[i] = i * 0.25;
+        ys[i] = (i % 7) - 3;  // Каждая седьмая строка дает деление на ноль
+    }
+    const calc_column_t columns[] = {{"x", xs}, {"y", ys}};
+    
+    assert(calc_set_variable(calc, "k", 2.0) == CALC_SUCCESS);
+    assert(calc_compile(calc, "k * x ^ 2 - sin(x) / y + (-x)", &expr) == CALC_SUCCESS);
+    assert(calc_eval_batch(calc, expr, columns, 2, COUNT, results, errors) == CALC_ERROR_INVALID_OPERATION);
+    
+    // Каждая строка совпадает с поштучным вычислением, ошибки отмечены только в своих строках
+    for (int i = 0; i < COUNT; i++) {
+        calc_set_variable(calc, "x", xs[i]);
+        calc_set_variable(calc, "y", ys[i]);
+        calc_error_t error = calc_eval_compiled(calc, expr, &result);
+        assert(errors[i] == error);
+        if (error == CALC_SUCCESS) {
+            assert(results[i] == result);
+        } else {
+            assert(ys[i] == 0);
+            assert(isnan(results[i]));
+        }
+    }
+    calc_free_compiled(expr);
+    
+    // Пакет без ошибок; маска ошибок необязательна
+    assert(calc_compile(calc, "x + y * 2", &expr) == CALC_SUCCESS);
+    assert(calc_eval_batch(calc, expr, columns, 2, COUNT, results, NULL) == CALC_SUCCESS);
+    assert(double_eq(results[COUNT - 1], xs[COUNT - 1] + ys[COUNT - 1] * 2));
+    calc_free_compiled(expr);
+    
+    // Переменная без столбца и без значения в контексте делает ошибочными все строки
+    assert(calc_compile(calc, "x + w", &expr) == CALC_SUCCESS);
+    assert(calc_eval_batch(calc, expr, columns, 1, COUNT, results, errors) == CALC_ERROR_UNDEFINED_VAR);
+    assert(errors[0] == CALC_ERROR_UNDEFINED_VAR && errors[COUNT - 1] == CALC_ERROR_UNDEFINED_VAR);
+    calc_free_compiled(expr);
+    
+    calc_destroy(calc);
+    printf("Batch evaluation tests passed\n");
+}
+
+static void test_variable_slots(void) {
+    calculator_ctx_t* calc = calc_create();
+    calc_expression_t* expr;
+    double result;
+    char name[32];
+    
+    // Количество переменных не ограничено
+    for (int i = 0; i < 5000; i++) {
+        sprintf(name, "v%d", i);
+        assert(calc_set_variable(calc, name, i) == CALC_SUCCESS);
+    }
+    for (int i = 0; i < 5000; i += 499) {
+        sprintf(name, "v%d", i);
+        assert(calc_get_variable(calc, name, &result) == CALC_SUCCESS);
+        assert(double_eq(result, i));
+    }
+    assert(calc_evaluate(calc, "v4999 - v17 * 2", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 4965.0));
+    
+    // Слот, полученный до присваивания, совпадает со слотом переменной после него
+    size_t slot, same_slot;
+    assert(calc_resolve_variable(calc, "t", &slot) == CALC_SUCCESS);
+    assert(calc_get_variable(calc, "t", &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_compile(calc, "t * 2 + v1", &expr) == CALC_SUCCESS);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_ERROR_UNDEFINED_VAR);
+    
+    for (int i = 0; i < 100; i++) {
+        assert(calc_set_variable_by_slot(calc, slot, i) == CALC_SUCCESS);
+        assert(calc_eval_compiled(calc, expr, &result) == CALC_SUCCESS);
+        assert(double_eq(result, 2.0 * i + 1));
+    }
+    assert(calc_set_variable(calc, "t", 0.5) == CALC_SUCCESS);
+    assert(calc_resolve_variable(calc, "t", &same_slot) == CALC_SUCCESS);
+    assert(same_slot == slot);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 2.0));
+    assert(calc_set_variable_by_slot(calc, 1000000, 1.0) == CALC_ERROR_UNDEFINED_VAR);
+    
+    // Скомпилированное выражение привязано к слотам своего контекста
+    calculator_ctx_t* other = calc_create();
+    assert(calc_eval_compiled(other, expr, &result) == CALC_ERROR_INVALID_OPERATION);
+    calc_destroy(other);
+    calc_free_compiled(expr);
+    
+    calc_destroy(calc);
+    printf("Variable slot tests passed\n");
+}
+
+static void test_long_expressions(void) {
+    calculator_ctx_t* calc = calc_create();
+    double result;
+    
+    // Выражение, для которого узлы и имена не помещаются в первый блок арены
+    const int terms = 2000;
+    const char* name = "a_rather_long_variable_name_to_fill_the_arena";
+    char* expression = malloc((size_t)terms * 64);
+    assert(expression != NULL);
+    char* end = expression;
+    for (int i = 0; i < terms; i++) {
+        end += sprintf(end, "%s(%s * 2 - %d)", i ? " + " : "", name, i);
+    }
+    
+    assert(calc_set_variable(calc, name, 1000.0) == CALC_SUCCESS);
+    assert(calc_evaluate(calc, expression, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 2000.0 * terms - (terms - 1.0) * terms / 2));
+    
+    // Ошибка в конце длинного выражения освобождает все разобранное до нее
+    strcpy(end, " + (");
+    assert(calc_evaluate(calc, expression, &result) == CALC_ERROR_SYNTAX);
+    
+    free(expression);
+    calc_destroy(calc);
+    printf("Long expression tests passed\n");
+}
+
+static void test_constant_folding(void) {
+    calculator_ctx_t* calc = calc_create();
+    double result;
+    
+    // Свернутые константы дают те же значения, что и вычисление без свертки
+    assert(calc_evaluate(calc, "2 ^ 10", &result) == CALC_SUCCESS);
+    assert(result == 1024.0);
+    assert(calc_evaluate(calc, "PI / 180", &result) == CALC_SUCCESS);
+    assert(result == PI / 180);
+    assert(calc_evaluate(calc, "sin(PI / 6) + cos(0) + 3!", &result) == CALC_SUCCESS);
+    assert(result == sin(PI / 6) + cos(0) + 6.0);
+    
+    calc_set_variable(calc, "x", 2.5);
+    assert(calc_evaluate(calc, "(1 + 1) * x * 1 / 1 ^ 1", &result) == CALC_SUCCESS);
+    assert(result == 5.0);
+    assert(calc_evaluate(calc, "-(-x) - 0", &result) == CALC_SUCCESS);
+    assert(result == 2.5);
+    
+    // Тождества сохраняют знак нуля: x * 1 и x - 0 равны x, а x + 0 для -0 дает +0
+    calc_set_variable(calc, "z", -0.0);
+    assert(calc_evaluate(calc, "z * 1", &result) == CALC_SUCCESS);
+    assert(result == 0 && signbit(result));
+    assert(calc_evaluate(calc, "z - 0", &result) == CALC_SUCCESS);
+    assert(result == 0 && signbit(result));
+    assert(calc_evaluate(calc, "z + 0", &result) == CALC_SUCCESS);
+    assert(result == 0 && !signbit(result));
+    assert(calc_evaluate(calc, "0 + z", &result) == CALC_SUCCESS);
+    assert(result == 0 && !signbit(result));
+    
+    // Поддеревья с ошибками не сворачиваются, и порядок ошибок сохраняется
+    assert(calc_evaluate(calc, "2 / (1 - 1)", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "(0 - 1)! * 1", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "1 / 0 + y", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "y * 1 + 1 / 0", &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_evaluate(calc, "y ^ 1", &result) == CALC_ERROR_UNDEFINED_VAR);
+    
+    calc_destroy(calc);
+    printf("Constant folding tests passed\n");
+}
+
+static double square(double x) {
+    return x * x;
+}
+
+static double cube(double x) {
+    return x * x * x;
+}
+
+static void test_registered_functions(void) {
+    calculator_ctx_t* calc = calc_create();
+    calc_expression_t* expr;
+    double result;
+    
+    assert(calc_register_unary_op(calc, "sqrt", sqrt) == CALC_SUCCESS);
+    assert(calc_register_unary_op(calc, "exp", exp) == CALC_SUCCESS);
+    assert(calc_register_binary_op(calc, "mod", fmod) == CALC_SUCCESS);
+    assert(calc_register_binary_op(calc, "hypot", hypot) == CALC_SUCCESS);
+    
+    assert(calc_evaluate(calc, "sqrt(16) + exp(0)", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 5.0));
+    assert(calc_evaluate(calc, "mod(10, 3)", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 1.0));
+    calc_set_variable(calc, "x", 3);
+    assert(calc_evaluate(calc, "hypot(x, x + 1) * 2 - mod(x * 5, sqrt(x + 1))", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 9.0));
+    
+    // Имя и количество аргументов определяют функцию; ошибки возникают после вычисления аргументов
+    assert(calc_evaluate(calc, "mod(10)", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "sin(1, 2)", &result) == CALC_ERROR_INVALID_OPERATION);
+    assert(calc_evaluate(calc, "mod(y, 0) + 1", &result) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_evaluate(calc, "mod(1, 2, 3)", &result) == CALC_ERROR_SYNTAX);
+    assert(calc_evaluate(calc, "mod(1, )", &result) == CALC_ERROR_SYNTAX);
+    assert(calc_evaluate(calc, "1, 2", &result) == CALC_ERROR_SYNTAX);
+    
+    assert(calc_register_unary_op(calc, "2x", square) == CALC_ERROR_SYNTAX);
+    assert(calc_register_unary_op(calc, "a+b", square) == CALC_ERROR_SYNTAX);
+    assert(calc_register_unary_op(calc, "sq", NULL) == CALC_ERROR_SYNTAX);
+    
+    // Скомпилированное выражение вызывает функцию, зарегистрированную на момент компиляции
+    assert(calc_register_unary_op(calc, "sq", square) == CALC_SUCCESS);
+    assert(calc_compile(calc, "sq(x)", &expr) == CALC_SUCCESS);
+    assert(calc_register_unary_op(calc, "sq", cube) == CALC_SUCCESS);
+    assert(calc_eval_compiled(calc, expr, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 9.0));
+    assert(calc_evaluate(calc, "sq(x)", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 27.0));
+    calc_free_compiled(expr);
+    
+    // Встроенные функции находятся в той же таблице и тоже могут быть заменены
+    assert(calc_register_unary_op(calc, "cos", square) == CALC_SUCCESS);
+    assert(calc_evaluate(calc, "cos(x)", &result) == CALC_SUCCESS);
+    assert(double_eq(result, 9.0));
+    
+    // Пакетное вычисление вызывает те же функции, неизвестная функция помечает все строки
+    const double xs[] = {1, 4, 9, 16, 25};
+    double results[5];
+    unsigned char errors[5];
+    calc_column_t column = {"x", xs};
+    assert(calc_compile(calc, "mod(sqrt(x), 3) + hypot(3, 4)", &expr) == CALC_SUCCESS);
+    assert(calc_eval_batch(calc, expr, &column, 1, 5, results, errors) == CALC_SUCCESS);
+    for (int i = 0; i < 5; i++) {
+        assert(errors[i] == CALC_SUCCESS);
+        assert(double_eq(results[i], fmod(sqrt(xs[i]), 3) + 5));
+    }
+    calc_free_compiled(expr);
+    assert(calc_compile(calc, "unknown(x, 2) + x", &expr) == CALC_SUCCESS);
+    assert(calc_eval_batch(calc, expr, &column, 1, 5, results, errors) == CALC_ERROR_INVALID_OPERATION);
+    for (int i = 0; i < 5; i++) {
+        assert(errors[i] == CALC_ERROR_INVALID_OPERATION && isnan(results[i]));
+    }
+    calc_free_compiled(expr);
+    
+    calc_destroy(calc);
+    printf("Registered function tests passed\n");
+}
+
+static void test_evaluation_frames(void) {
+    calculator_ctx_t* calc = calc_create();
+    calc_expression_t* expr;
+    double result;
+    size_t x_index, y_index;
+    
+    calc_set_variable(calc, "rate", 0.5);
+    assert(calc_compile(calc, "x * rate + y", &expr) == CALC_SUCCESS);
+    
+    // Кадр получает значения контекста на момент создания и дальше от него не зависит
+    calc_frame_t* first = calc_frame_create(expr);
+    calc_frame_t* second = calc_frame_create(expr);
+    assert(first && second);
+    assert(calc_frame_find_variable(first, "x", &x_index) == CALC_SUCCESS);
+    assert(calc_frame_find_variable(first, "y", &y_index) == CALC_SUCCESS);
+    assert(calc_frame_find_variable(first, "z", &y_index) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_eval_frame(first, &result) == CALC_ERROR_UNDEFINED_VAR);
+    
+    assert(calc_frame_set(first, x_index, 4) == CALC_SUCCESS);
+    assert(calc_frame_set_variable(first, "y", 1) == CALC_SUCCESS);
+    assert(calc_frame_set(second, x_index, 10) == CALC_SUCCESS);
+    assert(calc_frame_set_variable(second, "y", -1) == CALC_SUCCESS);
+    assert(calc_frame_set(second, 100, 1) == CALC_ERROR_UNDEFINED_VAR);
+    assert(calc_frame_set_variable(second, "z", 1) == CALC_ERROR_UNDEFINED_VAR);
+    
+    calc_set_variable(calc, "rate", 2);
+    assert(calc_eval_frame(first, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 3.0));
+    assert(calc_eval_frame(second, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 4.0));
+    assert(calc_get_variable(calc, "x", &result) == CALC_ERROR_UNDEFINED_VAR);
+    
+    calc_frame_destroy(first);
+    calc_frame_destroy(second);
+    calc_free_compiled(expr);
+    
+    // Выражение без переменных вычисляется в пустом кадре
+    assert(calc_compile(calc, "2 + 3", &expr) == CALC_SUCCESS);
+    first = calc_frame_create(expr);
+    assert(calc_eval_frame(first, &result) == CALC_SUCCESS);
+    assert(double_eq(result, 5.0));
+    calc_frame_destroy(first);
+    calc_free_compiled(expr);
+    
+    calc_destroy(calc);
+    printf("Evaluation frame tests passed\n");
+}
+
 int main(void) {
     printf("Running calculator tests...\n\n");
     
@@ -137,6 +485,14 @@ int main(void) {
     test_unary_operations();
     test_error_handling();
     test_complex_expressions();
+    test_compiled_expressions();
+    test_compiled_error_order();
+    test_batch_evaluation();
+    test_variable_slots();
+    test_long_expressions();
+    test_constant_folding();
+    test_registered_functions();
+    test_evaluation_frames();
     
     printf("\nAll tests passed successfully!\n");
     return 0;
@@ -0,0 +1,122 @@
+#include "calculator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+
+#define NUM_THREADS 8
+#define ITERATIONS 200000
+#define BATCH_SIZE 1000
+#define EPSILON 1e-9
+
+static double modulo(double a, double b) {
+    return fmod(a, b);
+}
+
+/**
+ * Общее для всех потоков выражение и ожидаемое значение, вычисленное на C
+ */
+static const char* const FORMULA = "notional * (1 + rate) ^ t - mod(t, 7) * sin(t / 100) / {1 + rate * rate}";
+
+static double formula(double notional, double rate, double t) {
+    return notional * pow(1 + rate, t) - fmod(t, 7) * sin(t / 100) / (1 + rate * rate);
+}
+
+typedef struct {
+    const calc_expression_t* compiled;
+    int id;
+    long failures;
+} worker_t;
+
+/**
+ * Поток вычисляет общее выражение в своем кадре и в своем контексте пакетом
+ */
+static void* worker(void* arg) {
+    worker_t* w = arg;
+    calc_frame_t* frame = calc_frame_create(w->compiled);
+    size_t rate_index, t_index;
+    if (!frame || calc_frame_find_variable(frame, "rate", &rate_index) != CALC_SUCCESS ||
+        calc_frame_find_variable(frame, "t", &t_index) != CALC_SUCCESS) {
+        w->failures++;
+        calc_frame_destroy(frame);
+        return NULL;
+    }
+    
+    // Значение notional унаследовано от контекста, остальные переменные у каждого потока свои
+    const double rate = 0.01 * (w->id + 1);
+    calc_frame_set(frame, rate_index, rate);
+    for (long i = 0; i < ITERATIONS; i++) {
+        const double t = (double)(i % 50);
+        double result;
+        calc_frame_set(frame, t_index, t);
+        if (calc_eval_frame(frame, &result) != CALC_SUCCESS ||
+            fabs(result - formula(1000, rate, t)) > EPSILON * fabs(result)) {
+            w->failures++;
+        }
+        
+        // Изменение значения в одном кадре не видно другим потокам
+        if (i % 1000 == 0) {
+            calc_frame_set(frame, rate_index, 0);
+            if (calc_eval_frame(frame, &result) != CALC_SUCCESS ||
+                fabs(result - formula(1000, 0, t)) > EPSILON * fabs(result)) {
+                w->failures++;
+            }
+            calc_frame_set(frame, rate_index, rate);
+        }
+    }
+    calc_frame_destroy(frame);
+    
+    // Разбор выполняется параллельно: арены и таблицы у каждого контекста свои
+    calculator_ctx_t* calc = calc_create();
+    calc_register_binary_op(calc, "mod", modulo);
+    calc_set_variable(calc, "notional", 1000);
+    calc_set_variable(calc, "rate", rate);
+    calc_expression_t* own = NULL;
+    if (!calc || calc_compile(calc, FORMULA, &own) != CALC_SUCCESS) {
+        w->failures++;
+    } else {
+        double ts[BATCH_SIZE], results[BATCH_SIZE];
+        for (int i = 0; i < BATCH_SIZE; i++) ts[i] = i % 50;
+        calc_column_t column = {"t", ts};
+        if (calc_eval_batch(calc, own, &column, 1, BATCH_SIZE, results, NULL) != CALC_SUCCESS) w->failures++;
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            if (fabs(results[i] - formula(1000, rate, ts[i])) > EPSILON * fabs(results[i])) w->failures++;
+        }
+    }
+    calc_free_compiled(own);
+    calc_destroy(calc);
+    return NULL;
+}
+
+int main(void) {
+    printf("Running multithreaded evaluation tests...\n\n");
+    
+    calculator_ctx_t* calc = calc_create();
+    assert(calc_register_binary_op(calc, "mod", modulo) == CALC_SUCCESS);
+    assert(calc_set_variable(calc, "notional", 1000) == CALC_SUCCESS);
+    
+    calc_expression_t* compiled;
+    assert(calc_compile(calc, FORMULA, &compiled) == CALC_SUCCESS);
+    
+    pthread_t threads[NUM_THREADS];
+    worker_t workers[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        workers[i].compiled = compiled;
+        workers[i].id = i;
+        workers[i].failures = 0;
+        assert(pthread_create(&threads[i], NULL, worker, &workers[i]) == 0);
+    }
+    
+    long failures = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        assert(pthread_join(threads[i], NULL) == 0);
+        failures += workers[i].failures;
+    }
+    assert(failures == 0);
+    
+    calc_free_compiled(compiled);
+    calc_destroy(calc);
+    printf("%d threads x %d evaluations of a shared expression passed\n", NUM_THREADS, ITERATIONS);
+    return 0;
+}
@@ -0,0 +1,213 @@
+#!/bin/sh
+# Воспроизводимый замер sort_bigdatafile: для каждого сценария создается входной
+# файл (gen_bigdatafile с фиксированным зерном), выполняется сортировка со статистикой
+# --stats=json, результат проверяется check_sorted, а строка с итогами дописывается
+# в файл результатов в формате JSON Lines.
+#
+# Переменные окружения:
+#   BENCH_LINES    количество строк основных сценариев (по умолчанию 1000000)
+#   BENCH_SEED     зерно генератора (по умолчанию 1)
+#   BENCH_DIR      каталог входных файлов и результатов (по умолчанию bench_data)
+#   BENCH_FLAGS    дополнительные опции sort_bigdatafile, например "--memory-limit=64M"
+#   BENCH_RESULTS  файл результатов (по умолчанию $BENCH_DIR/results.jsonl)
+#   BENCH_MEMORY   лимит памяти проверки пикового объема памяти (по умолчанию 32M)
+
+set -u
+
+LINES=${BENCH_LINES:-1000000}
+SEED=${BENCH_SEED:-1}
+DIR=${BENCH_DIR:-bench_data}
+FLAGS=${BENCH_FLAGS:-}
+RESULTS=${BENCH_RESULTS:-$DIR/results.jsonl}
+MEMORY=${BENCH_MEMORY:-32M}
+
+mkdir -p "$DIR" || exit 1
+
+failures=0
+
+# run_case <имя> <число строк> <опции генератора...>
+run_case() {
+    name=$1
+    lines=$2
+    shift 2
+
+    input="$DIR/$name-$lines-$SEED.txt"
+    output="$DIR/$name.sorted.txt"
+    stats="$DIR/$name.stats"
+
+    # Входной файл определяется именем, числом строк и зерном, поэтому создается один раз
+    if [ ! -f "$input" ]; then
+        ./gen_bigdatafile --lines="$lines" --seed="$SEED" --tagged "$@" "$input" || exit 1
+    fi
+
+    if ./sort_bigdatafile --stats=json $FLAGS "$input" "$output" > /dev/null 2> "$stats"; then
+        if ./check_sorted --tagged "$input" "$output" > /dev/null; then
+            check=ok
+        else
+            check=failed
+        fi
+    else
+        check=sort_failed
+    fi
+    [ "$check" = ok ] || failures=$((failures + 1))
+
+    json=$(grep '^{' "$stats" | tail -n 1)
+    [ -n "$json" ] || json=null
+    printf '{"scenario":"%s","lines":%s,"seed":%s,"flags":"%s","check":"%s","stats":%s}\n' \
+        "$name" "$lines" "$SEED" "$FLAGS" "$check" "$json" >> "$RESULTS"
+
+    seconds=$(printf '%s' "$json" | sed -n 's/.*"total_seconds":\([0-9.]*\).*/\1/p')
+    printf '%-12s %10s строк  %-11s %s с\n' "$name" "$lines" "$check" "${seconds:--}"
+
+    rm -f "$output" "$stats"
+}
+
+# limit_kib <объем с необязательным суффиксом K, M или G> - объем в КиБ
+limit_kib() {
+    case $1 in
+        *[Kk]) echo $(( ${1%?} )) ;;
+        *[Mm]) echo $(( ${1%?} * 1024 )) ;;
+        *[Gg]) echo $(( ${1%?} * 1024 * 1024 )) ;;
+        *) echo $(( $1 / 1024 )) ;;
+    esac
+}
+
+# check_memory <имя> <опции sort_bigdatafile...>
+# Сортирует входной файл сценария uniform с --memory-limit=$BENCH_MEMORY и следит
+# за пиковым объемом резидентной памяти процесса (VmHWM в /proc): он не должен
+# превышать лимит ни на одном этапе
+check_memory() {
+    name=$1
+    shift
+
+    input="$DIR/uniform-$LINES-$SEED.txt"
+    output="$DIR/$name.sorted.txt"
+    limit=$(limit_kib "$MEMORY")
+
+    ./sort_bigdatafile --memory-limit="$MEMORY" "$@" "$input" "$output" > /dev/null 2>&1 &
+    pid=$!
+    peak=0
+    # У завершившегося процесса в status нет строк Vm*: это и есть конец наблюдения
+    while hwm=$(sed -n 's/^VmHWM:[[:space:]]*\([0-9]*\) kB$/\1/p' "/proc/$pid/status" 2> /dev/null) && [ -n "$hwm" ]; do
+        [ "$hwm" -gt "$peak" ] && peak=$hwm
+        sleep 0.01
+    done
+    if ! wait "$pid"; then
+        check=sort_failed
+    elif ! ./check_sorted --tagged "$input" "$output" > /dev/null; then
+        check=failed
+    elif [ "$peak" -gt "$limit" ]; then
+        check=over_limit
+    else
+        check=ok
+    fi
+    [ "$check" = ok ] || failures=$((failures + 1))
+
+    printf '{"scenario":"%s","lines":%s,"seed":%s,"flags":"%s","check":"%s","peak_rss_kib":%s,"limit_kib":%s}\n' \
+        "$name" "$LINES" "$SEED" "$*" "$check" "$peak" "$limit" >> "$RESULTS"
+    printf '%-12s %10s КиБ  %-11s лимит %s КиБ\n' "$name" "$peak" "$check" "$limit"
+
+    rm -f "$output"
+}
+
+# check_resume <имя> <опции sort_bigdatafile...>
+# Сортировку входного файла сценария uniform с --manifest дважды прерывает сигнал
+# KILL (через 0.2 и 0.5 с; каждый запуск продолжает предыдущий), затем она
+# завершается. Результат должен быть верным, а в каталоге временных файлов
+# не должно остаться ни временных файлов, ни манифеста
+check_resume() {
+    name=$1
+    shift
+    flags=$*
+
+    input="$DIR/uniform-$LINES-$SEED.txt"
+    output="$DIR/$name.sorted.txt"
+    tmp="$DIR/$name.tmp"
+    rm -rf "$tmp"
+    mkdir -p "$tmp" || exit 1
+    set -- --manifest="$tmp/manifest" --tmp-dir="$tmp" "$@"
+
+    for delay in 0.2 0.5; do
+        ./sort_bigdatafile "$@" "$input" "$output" > /dev/null 2>&1 &
+        pid=$!
+        sleep "$delay"
+        kill -9 "$pid" 2> /dev/null
+        wait "$pid" 2> /dev/null
+    done
+    if ! ./sort_bigdatafile "$@" "$input" "$output" > /dev/null 2>&1; then
+        check=sort_failed
+    elif ! ./check_sorted --tagged "$input" "$output" > /dev/null; then
+        check=failed
+    elif [ -n "$(ls -A "$tmp")" ]; then
+        check=files_left
+    else
+        check=ok
+    fi
+    [ "$check" = ok ] || failures=$((failures + 1))
+
+    printf '{"scenario":"%s","lines":%s,"seed":%s,"flags":"%s","check":"%s"}\n' \
+        "$name" "$LINES" "$SEED" "$flags" "$check" >> "$RESULTS"
+    printf '%-12s %10s строк  %s\n' "$name" "$LINES" "$check"
+
+    rm -rf "$output" "$tmp"
+}
+
+# check_shared_tmp <имя> <опции sort_bigdatafile...>
+# Две одновременные сортировки разных входных файлов (сценарии uniform и duplicates)
+# в одинаково названные файлы двух каталогов с общим --tmp-dir. Временные файлы
+# не должны совпасть по имени: оба результата должны быть верными, а общий
+# каталог после сортировок - пустым
+check_shared_tmp() {
+    name=$1
+    shift
+    flags=$*
+
+    tmp="$DIR/$name.tmp"
+    rm -rf "$tmp" "$DIR/$name.a" "$DIR/$name.b"
+    mkdir -p "$tmp" "$DIR/$name.a" "$DIR/$name.b" || exit 1
+
+    ./sort_bigdatafile --tmp-dir="$tmp" "$@" "$DIR/uniform-$LINES-$SEED.txt" "$DIR/$name.a/sorted.txt" > /dev/null 2>&1 &
+    pid=$!
+    if ! ./sort_bigdatafile --tmp-dir="$tmp" "$@" "$DIR/duplicates-$LINES-$SEED.txt" "$DIR/$name.b/sorted.txt" > /dev/null 2>&1; then
+        wait "$pid"
+        check=sort_failed
+    elif ! wait "$pid"; then
+        check=sort_failed
+    elif ! ./check_sorted --tagged "$DIR/uniform-$LINES-$SEED.txt" "$DIR/$name.a/sorted.txt" > /dev/null ||
+         ! ./check_sorted --tagged "$DIR/duplicates-$LINES-$SEED.txt" "$DIR/$name.b/sorted.txt" > /dev/null; then
+        check=failed
+    elif [ -n "$(ls -A "$tmp")" ]; then
+        check=files_left
+    else
+        check=ok
+    fi
+    [ "$check" = ok ] || failures=$((failures + 1))
+
+    printf '{"scenario":"%s","lines":%s,"seed":%s,"flags":"%s","check":"%s"}\n' \
+        "$name" "$LINES" "$SEED" "$flags" "$check" >> "$RESULTS"
+    printf '%-12s %10s строк  %s\n' "$name" "$LINES" "$check"
+
+    rm -rf "$tmp" "$DIR/$name.a" "$DIR/$name.b"
+}
+
+run_case uniform    "$LINES"
+run_case duplicates "$LINES" --keys=duplicates --distinct=100
+run_case sorted     "$LINES" --keys=sorted
+run_case reversed   "$LINES" --keys=reversed
+run_case long       $((LINES / 20 + 1)) --value-length=200-2000
+
+if [ -r /proc/self/status ]; then
+    check_memory memory
+    check_memory memory-mt --threads=4
+    check_memory memory-keys --strategy=keys
+else
+    echo "Проверка пикового объема памяти пропущена: нет /proc"
+fi
+
+check_resume resume      --memory-limit=8M --threads=4
+check_resume resume-keys --memory-limit=8M --strategy=keys
+
+check_shared_tmp shared-tmp --memory-limit=8M
+
+echo "Результаты дописаны в $RESULTS"
+[ "$failures" -eq 0 ]
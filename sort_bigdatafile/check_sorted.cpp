@@ -0,0 +1,181 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include <system_error>
+#include <string_view>
+
+// Проверка результата sort_bigdatafile. Проверяется, что:
+//   - ключи файла результата не убывают;
+//   - результат содержит ровно те же пары ключ-значение, что и корректные строки
+//     входного файла (сравниваются количество и сумма хешей пар, не зависящая от порядка);
+//   - с опцией --tagged порядок равных ключей устойчив: значения, созданные
+//     gen_bigdatafile --tagged, оканчиваются номером исходной строки
+
+// Количество символов номера строки в конце значения (см. gen_bigdatafile.cpp)
+constexpr size_t TAG_LENGTH = 8;
+
+// Алфавит номера строки: система счисления по основанию 62
+constexpr char ALPHABET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+// Разбор строки по тем же правилам, что и в sort_bigdatafile
+bool splitKeyValue(std::string_view line, uint64_t& key, std::string_view& value) {
+    size_t colonPos = line.find(':');
+    if (colonPos == std::string_view::npos) {
+        return false;
+    }
+    const char* start = line.data();
+    auto result = std::from_chars(start, start + colonPos, key);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    value = line.substr(colonPos + 1);
+    return true;
+}
+
+// Перемешивание бит SplitMix64
+uint64_t mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+// Хеш пары ключ-значение (FNV-1a по значению, перемешанный с ключом)
+uint64_t pairHash(uint64_t key, std::string_view value) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char c : value) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return mix(hash ^ mix(key));
+}
+
+// Номер исходной строки, записанный в конце значения; false - если его там нет
+bool parseTag(std::string_view value, uint64_t& tag) {
+    if (value.size() < TAG_LENGTH) {
+        return false;
+    }
+    tag = 0;
+    for (const char c : value.substr(value.size() - TAG_LENGTH)) {
+        const char* digit = std::char_traits<char>::find(ALPHABET, sizeof(ALPHABET) - 1, c);
+        if (!digit) {
+            return false;
+        }
+        tag = tag * (sizeof(ALPHABET) - 1) + static_cast<uint64_t>(digit - ALPHABET);
+    }
+    return true;
+}
+
+// Сводка по парам файла
+struct FileDigest {
+    uint64_t pairs = 0;
+    uint64_t hashSum = 0;
+};
+
+// Открывает файл для построчного чтения с крупным буфером
+bool openFile(std::ifstream& file, std::vector<char>& buffer, const std::string& path) {
+    buffer.resize(size_t(1) << 20);
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Ошибка: не удалось открыть файл " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Читает корректные строки входного файла
+bool digestInput(const std::string& path, FileDigest& digest) {
+    std::ifstream file;
+    std::vector<char> buffer;
+    if (!openFile(file, buffer, path)) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        uint64_t key = 0;
+        std::string_view value;
+        if (splitKeyValue(line, key, value)) {
+            digest.pairs++;
+            digest.hashSum += pairHash(key, value);
+        }
+    }
+    return !file.bad();
+}
+
+// Читает файл результата и проверяет порядок его строк
+bool checkOutput(const std::string& path, bool tagged, FileDigest& digest) {
+    std::ifstream file;
+    std::vector<char> buffer;
+    if (!openFile(file, buffer, path)) {
+        return false;
+    }
+    std::string line;
+    uint64_t lineNumber = 0;
+    uint64_t previousKey = 0;
+    uint64_t previousTag = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        uint64_t key = 0;
+        std::string_view value;
+        if (!splitKeyValue(line, key, value)) {
+            std::cerr << "Ошибка: строка " << lineNumber << " результата не разбирается: " << line << std::endl;
+            return false;
+        }
+        if (lineNumber > 1 && key < previousKey) {
+            std::cerr << "Ошибка: нарушен порядок ключей в строке " << lineNumber << std::endl;
+            return false;
+        }
+
+        uint64_t tag = 0;
+        if (tagged) {
+            if (!parseTag(value, tag)) {
+                std::cerr << "Ошибка: в строке " << lineNumber << " нет номера исходной строки" << std::endl;
+                return false;
+            }
+            if (lineNumber > 1 && key == previousKey && tag <= previousTag) {
+                std::cerr << "Ошибка: нарушена устойчивость порядка в строке " << lineNumber << std::endl;
+                return false;
+            }
+        }
+
+        previousKey = key;
+        previousTag = tag;
+        digest.pairs++;
+        digest.hashSum += pairHash(key, value);
+    }
+    return !file.bad();
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    bool tagged = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tagged") {
+            tagged = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2) {
+        std::cerr << "Использование: " << argv[0] << " [--tagged] <входной_файл> <файл_результата>" << std::endl;
+        return 2;
+    }
+
+    FileDigest input;
+    FileDigest output;
+    if (!checkOutput(positional[1], tagged, output) || !digestInput(positional[0], input)) {
+        return 1;
+    }
+    if (input.pairs != output.pairs || input.hashSum != output.hashSum) {
+        std::cerr << "Ошибка: состав строк результата не совпадает с входным файлом (строк "
+                  << output.pairs << " вместо " << input.pairs << ")" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Проверка пройдена: " << output.pairs << " строк" << std::endl;
+    return 0;
+}
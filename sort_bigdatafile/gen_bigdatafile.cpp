@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include <system_error>
+
+// Быстрый воспроизводимый генератор тестовых файлов для sort_bigdatafile.
+// В отличие от gen_bigdatafile.py не требует ввода, задается опциями и при одинаковом
+// зерне всегда создает один и тот же файл
+
+// Распределение ключей
+enum class KeyOrder {
+    Uniform,    // случайные 64-битные ключи
+    Duplicates, // ключи из небольшого набора случайных значений
+    Sorted,     // возрастающие ключи
+    Reversed    // убывающие ключи
+};
+
+// Параметры генерации
+struct GeneratorOptions {
+    uint64_t lines = 1000000;             // количество строк
+    uint64_t seed = 1;                    // зерно генератора
+    KeyOrder order = KeyOrder::Uniform;   // распределение ключей
+    uint64_t distinctKeys = 1000;         // число различных ключей для duplicates
+    size_t minValue = 5;                  // наименьшая длина значения
+    size_t maxValue = 15;                 // наибольшая длина значения
+    bool tagged = false;                  // дописывать к значению номер строки
+};
+
+// Количество символов номера строки, дописываемого к значению в режиме --tagged
+constexpr size_t TAG_LENGTH = 8;
+
+// Цифро-буквенный алфавит значений; его порядок задает и кодирование номера строки
+constexpr char ALPHABET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+constexpr size_t ALPHABET_SIZE = sizeof(ALPHABET) - 1;
+
+// Генератор псевдослучайных чисел SplitMix64: быстрый и одинаковый на всех платформах
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Случайное число из диапазона [low, high]
+    uint64_t range(uint64_t low, uint64_t high) {
+        const uint64_t span = high - low + 1;
+        return span == 0 ? next() : low + next() % span;
+    }
+};
+
+// Создает файл path со строками вида <ключ>:<значение>
+bool generateFile(const std::string& path, const GeneratorOptions& options) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Ошибка: не удалось создать файл " << path << std::endl;
+        return false;
+    }
+
+    Random random(options.seed);
+
+    std::vector<uint64_t> pool;
+    if (options.order == KeyOrder::Duplicates) {
+        pool.resize(std::max<uint64_t>(1, options.distinctKeys));
+        for (auto& key : pool) {
+            key = random.next();
+        }
+    }
+
+    // Шаг упорядоченных ключей выбирается так, чтобы они не переполнили 64 бита
+    const uint64_t maxStep = std::max<uint64_t>(1, UINT64_MAX / std::max<uint64_t>(1, options.lines));
+    uint64_t orderedKey = options.order == KeyOrder::Reversed ? UINT64_MAX : 0;
+
+    constexpr size_t BLOCK_SIZE = size_t(1) << 20;
+    std::string block;
+    block.reserve(BLOCK_SIZE + options.maxValue + TAG_LENGTH + 32);
+
+    for (uint64_t line = 0; line < options.lines; ++line) {
+        uint64_t key = 0;
+        switch (options.order) {
+            case KeyOrder::Uniform:
+                key = random.next();
+                break;
+            case KeyOrder::Duplicates:
+                key = pool[random.next() % pool.size()];
+                break;
+            case KeyOrder::Sorted:
+                // Средний шаг - половина наибольшего, поэтому ключи заполняют примерно половину диапазона
+                orderedKey += random.range(0, maxStep);
+                key = orderedKey;
+                break;
+            case KeyOrder::Reversed:
+                orderedKey -= random.range(0, maxStep);
+                key = orderedKey;
+                break;
+        }
+
+        char digits[20];
+        const char* digitsEnd = std::to_chars(digits, digits + sizeof(digits), key).ptr;
+        block.append(digits, digitsEnd - digits);
+        block.push_back(':');
+
+        const size_t length = static_cast<size_t>(random.range(options.minValue, options.maxValue));
+        for (size_t i = 0; i < length; ++i) {
+            block.push_back(ALPHABET[random.next() % ALPHABET_SIZE]);
+        }
+        if (options.tagged) {
+            // Номер строки в системе счисления по основанию 62 фиксированной ширины
+            char tag[TAG_LENGTH];
+            uint64_t number = line;
+            for (size_t i = TAG_LENGTH; i > 0; --i) {
+                tag[i - 1] = ALPHABET[number % ALPHABET_SIZE];
+                number /= ALPHABET_SIZE;
+            }
+            block.append(tag, TAG_LENGTH);
+        }
+        block.push_back('\n');
+
+        if (block.size() >= BLOCK_SIZE) {
+            file.write(block.data(), block.size());
+            block.clear();
+        }
+    }
+    file.write(block.data(), block.size());
+
+    if (!file.flush()) {
+        std::cerr << "Ошибка: не удалось записать файл " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Выводит справку по использованию программы
+void printUsage(const char* programName) {
+    std::cerr << "Использование: " << programName << " [опции] <выходной_файл>" << std::endl;
+    std::cerr << "Опции:" << std::endl;
+    std::cerr << "  --lines=N            количество строк (по умолчанию 1000000)" << std::endl;
+    std::cerr << "  --seed=N             зерно генератора (по умолчанию 1)" << std::endl;
+    std::cerr << "  --keys=K             ключи: uniform (по умолчанию), duplicates, sorted, reversed" << std::endl;
+    std::cerr << "  --distinct=N         число различных ключей для --keys=duplicates (по умолчанию 1000)" << std::endl;
+    std::cerr << "  --value-length=A-B   длина значения от A до B символов (по умолчанию 5-15)" << std::endl;
+    std::cerr << "  --tagged             дописывать к значению номер строки для проверки устойчивости" << std::endl;
+}
+
+// Разбирает числовое значение опции
+bool parseNumber(const std::string& text, uint64_t& value) {
+    const char* start = text.data();
+    const char* end = start + text.size();
+    auto result = std::from_chars(start, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Разбирает опцию командной строки вида --имя=значение
+bool parseOption(const std::string& arg, GeneratorOptions& options) {
+    const size_t eqPos = arg.find('=');
+    const std::string name = arg.substr(0, eqPos);
+    const std::string value = eqPos == std::string::npos ? std::string() : arg.substr(eqPos + 1);
+
+    if (name == "--lines") {
+        return parseNumber(value, options.lines);
+    }
+    if (name == "--seed") {
+        return parseNumber(value, options.seed);
+    }
+    if (name == "--distinct") {
+        return parseNumber(value, options.distinctKeys) && options.distinctKeys > 0;
+    }
+    if (name == "--tagged") {
+        options.tagged = true;
+        return eqPos == std::string::npos;
+    }
+    if (name == "--keys") {
+        if (value == "uniform") {
+            options.order = KeyOrder::Uniform;
+        } else if (value == "duplicates") {
+            options.order = KeyOrder::Duplicates;
+        } else if (value == "sorted") {
+            options.order = KeyOrder::Sorted;
+        } else if (value == "reversed") {
+            options.order = KeyOrder::Reversed;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (name == "--value-length") {
+        const size_t dashPos = value.find('-');
+        uint64_t low = 0;
+        uint64_t high = 0;
+        if (dashPos == std::string::npos) {
+            if (!parseNumber(value, low)) {
+                return false;
+            }
+            high = low;
+        } else if (!parseNumber(value.substr(0, dashPos), low) || !parseNumber(value.substr(dashPos + 1), high)) {
+            return false;
+        }
+        if (low > high) {
+            return false;
+        }
+        options.minValue = static_cast<size_t>(low);
+        options.maxValue = static_cast<size_t>(high);
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    GeneratorOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+        } else if (!parseOption(arg, options)) {
+            std::cerr << "Ошибка: некорректная опция " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (positional.size() != 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    return generateFile(positional[0], options) ? 0 : 1;
+}
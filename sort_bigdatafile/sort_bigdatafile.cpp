@@ -8,226 +8,3017 @@
 #include <charconv>
 #include <system_error>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <future>
+#include <functional>
+#include <memory>
+#include <array>
+#include <sstream>
+#include <iomanip>
 
-// Структура для хранения пары ключ-значение и исходной позиции
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <filesystem>
+
+// Структура для хранения пары ключ-значение.
+// Исходная позиция не хранится: внутри временного файла записи идут в порядке
+// устойчивой сортировки, а сами файлы пронумерованы в порядке чтения
 struct KeyValuePair {
-    uint64_t key;         // ключ
-    std::string value;    // значение
-    size_t originalIndex; // исходная позиция для обеспечения устойчивости сортировки
+    uint64_t key;           // ключ
+    std::string_view value; // значение (указывает в буфер чтения временного файла)
 };
 
-// Функция для разбора строки на ключ и значение
-bool parseKeyValue(const std::string& line, KeyValuePair& pair) {
-    size_t colonPos = line.find(':');
-    if (colonPos == std::string::npos) {
+// Находит первый символ ':' или '\n' в [position, end); end, если их нет.
+// Блок проверяется по 32 (AVX2) или 16 (SSE2) байт за сравнение, остаток - побайтно
+inline const char* findSeparator(const char* position, const char* end) {
+#if defined(__AVX2__)
+    const __m256i colons = _mm256_set1_epi8(':');
+    const __m256i newlines = _mm256_set1_epi8('\n');
+    for (; end - position >= 32; position += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position));
+        const __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colons), _mm256_cmpeq_epi8(chunk, newlines));
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(found));
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i colons16 = _mm_set1_epi8(':');
+    const __m128i newlines16 = _mm_set1_epi8('\n');
+    for (; end - position >= 16; position += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, colons16), _mm_cmpeq_epi8(chunk, newlines16));
+        const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(found));
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; position < end; ++position) {
+        if (*position == ':' || *position == '\n') {
+            break;
+        }
+    }
+    return position;
+}
+
+// Проверяет, что 8 байт начиная с position - десятичные цифры, и переводит их
+// в число без цикла по байтам (SWAR: все цифры обрабатываются одним 64-битным словом)
+inline bool parseEightDigits(const char* position, uint64_t& value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t chunk;
+    std::memcpy(&chunk, position, sizeof(chunk));
+    // Каждый байт должен лежать в диапазоне '0'..'9'
+    if ((chunk & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull ||
+        ((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) != 0x3030303030303030ull) {
+        return false;
+    }
+    chunk -= 0x3030303030303030ull;
+    chunk = chunk * 10 + (chunk >> 8);
+    value = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+    return true;
+#else
+    uint64_t result = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        const unsigned digit = static_cast<unsigned char>(position[i]) - '0';
+        if (digit > 9) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = result;
+    return true;
+#endif
+}
+
+// Разбирает ключ в начале [begin, end) по правилам std::from_chars: ведущие цифры,
+// ошибка при их отсутствии или переполнении uint64_t; символы после цифр допустимы
+inline bool parseKey(const char* begin, const char* end, uint64_t& key) {
+    auto isDigit = [](char c) { return static_cast<unsigned>(static_cast<unsigned char>(c) - '0') < 10u; };
+    
+    // Ведущие нули не влияют на значение и не участвуют в проверке переполнения
+    const char* position = begin;
+    while (position < end && *position == '0') {
+        ++position;
+    }
+    
+    // До 19 значащих цифр переполнение невозможно: сначала по 8 цифр, затем по одной
+    uint64_t value = 0;
+    size_t digits = 0;
+    uint64_t eight = 0;
+    while (end - position >= 8 && digits + 8 <= 19 && parseEightDigits(position, eight)) {
+        value = value * 100000000 + eight;
+        position += 8;
+        digits += 8;
+    }
+    while (position < end && digits < 19 && isDigit(*position)) {
+        value = value * 10 + static_cast<uint64_t>(*position - '0');
+        ++position;
+        ++digits;
+    }
+    
+    // Двадцатая значащая цифра может переполнить значение, двадцать первая - всегда
+    if (position < end && isDigit(*position)) {
+        const uint64_t digit = static_cast<uint64_t>(*position - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+        ++position;
+        if (position < end && isDigit(*position)) {
+            return false;
+        }
+    }
+    
+    if (position == begin) {
+        return false; // Ключ не начинается с цифры
+    }
+    key = value;
+    return true;
+}
+
+// Функция для разбора строки на ключ и значение без копирования значения
+bool splitKeyValue(std::string_view line, uint64_t& key, std::string_view& value) {
+    const char* start = line.data();
+    const char* end = start + line.size();
+    const char* colon = findSeparator(start, end);
+    if (colon == end || *colon != ':') {
         return false; // Не найдено двоеточие
     }
-
-    // Попытка преобразовать ключ в uint64_t
-    const char* start = line.data();
-    const char* end = start + colonPos;
-    auto result = std::from_chars(start, end, pair.key);
-    if (result.ec != std::errc()) {
-        return false; // Ошибка при преобразовании ключа
+
+    // Попытка преобразовать ключ в uint64_t
+    if (!parseKey(start, colon, key)) {
+        return false; // Ошибка при преобразовании ключа
+    }
+
+    value = std::string_view(colon + 1, end - colon - 1);
+    return true;
+}
+
+// Фоновые потоки ввода-вывода. Выполняют операции чтения и записи файлов,
+// пока основные потоки разбирают, сортируют и сливают данные
+class IoExecutor {
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::packaged_task<size_t()>> tasks;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+    
+    void run() {
+        while (true) {
+            std::packaged_task<size_t()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return !tasks.empty() || stopping; });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit IoExecutor(size_t threadCount) {
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+    
+    // Дожидается выполнения всех поставленных операций
+    ~IoExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+    
+    // Ставит операцию в очередь; результат операции доступен через future
+    std::future<size_t> submit(std::function<size_t()> job) {
+        std::packaged_task<size_t()> task(std::move(job));
+        std::future<size_t> result = task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        ready.notify_one();
+        return result;
+    }
+};
+
+// Блочное чтение файла. Данные читаются крупными блоками, а строки и записи
+// выделяются прямо в буфере без промежуточных копий.
+// При переданном IoExecutor чтение идет с упреждением: пока разбирается текущий блок,
+// следующий читается в фоне во второй буфер. Блок читается в буфер с отступом
+// в четверть размера, куда переносится недочитанный хвост предыдущего блока
+class BlockReader {
+private:
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t begin = 0;     // начало непрочитанных данных в буфере
+    size_t end = 0;       // конец данных в буфере
+    bool atEof = false;   // файл прочитан до конца
+    uint64_t remaining;   // сколько байт файла еще можно прочитать
+    
+    IoExecutor* const io;          // фоновые потоки или nullptr для синхронного чтения
+    const size_t blockSize;
+    std::vector<char> spare;       // буфер, заполняемый в фоне
+    std::future<size_t> pending;   // незавершенное фоновое чтение
+    size_t pendingSize = 0;        // размер запрошенного фонового чтения
+    std::atomic<bool> ioFailed{false};
+    
+    size_t headroom() const {
+        return blockSize / 4;
+    }
+    
+    // Запускает фоновое чтение следующего блока в запасной буфер
+    void readAhead() {
+        spare.resize(blockSize);
+        pendingSize = static_cast<size_t>(std::min<uint64_t>(blockSize - headroom(), remaining));
+        remaining -= pendingSize;
+        pending = io->submit([this] {
+            file.read(spare.data() + headroom(), pendingSize);
+            if (file.bad()) {
+                ioFailed = true;
+            }
+            return static_cast<size_t>(file.gcount());
+        });
+    }
+    
+    // Переносит непрочитанный остаток в начало буфера и дочитывает файл.
+    // Буфер расширяется, если в нем нет места хотя бы для minFree байт
+    bool refill(size_t minFree = 1) {
+        if (atEof) {
+            return false;
+        }
+        if (io) {
+            return refillAhead();
+        }
+        if (begin > 0) {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        if (buffer.size() - end < minFree) {
+            buffer.resize(std::max(end + minFree, 2 * buffer.size()));
+        }
+        
+        const size_t request = static_cast<size_t>(std::min<uint64_t>(buffer.size() - end, remaining));
+        file.read(buffer.data() + end, request);
+        const size_t count = static_cast<size_t>(file.gcount());
+        end += count;
+        remaining -= request;
+        if (!file || remaining == 0) {
+            atEof = true; // Конец файла или диапазона либо ошибка чтения (см. failed)
+        }
+        return count > 0;
+    }
+    
+    // Забирает блок, прочитанный в фоне, и сразу запускает чтение следующего
+    bool refillAhead() {
+        if (!pending.valid()) {
+            atEof = true;
+            return false;
+        }
+        const size_t count = pending.get();
+        const size_t leftover = end - begin;
+        
+        if (leftover <= headroom()) {
+            std::memcpy(spare.data() + headroom() - leftover, buffer.data() + begin, leftover);
+            buffer.swap(spare);
+            begin = headroom() - leftover;
+            end = headroom() + count;
+        } else {
+            // Хвост длиннее отступа (очень длинная строка или запись): склеиваем копированием
+            std::vector<char> joined(leftover + count);
+            std::memcpy(joined.data(), buffer.data() + begin, leftover);
+            std::memcpy(joined.data() + leftover, spare.data() + headroom(), count);
+            spare.swap(buffer);
+            buffer.swap(joined);
+            begin = 0;
+            end = leftover + count;
+        }
+        
+        if (count < pendingSize || remaining == 0) {
+            atEof = true;
+        } else {
+            readAhead();
+        }
+        return count > 0;
+    }
+
+public:
+    // Читает length байт файла начиная с позиции offset (по умолчанию - весь файл)
+    BlockReader(const std::string& path, size_t blockSize, IoExecutor* io = nullptr,
+                uint64_t offset = 0, uint64_t length = UINT64_MAX)
+        : buffer(io ? 0 : blockSize), remaining(length), io(io), blockSize(blockSize) {
+        // Собственный буфер потока не нужен: чтение идет блоками не меньше него
+        file.rdbuf()->pubsetbuf(nullptr, 0);
+        file.open(path, std::ios::binary);
+        if (offset != 0 && file.is_open()) {
+            file.seekg(static_cast<std::streamoff>(offset));
+        }
+        if (io && file.is_open()) {
+            readAhead();
+        }
+    }
+    
+    // Фоновая операция обращается к полям читателя, поэтому ее нужно дождаться
+    ~BlockReader() {
+        if (pending.valid()) {
+            pending.wait();
+        }
+    }
+    
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+    
+    explicit operator bool() const {
+        return file.is_open();
+    }
+    
+    // Произошла ли ошибка чтения
+    bool failed() const {
+        return io ? ioFailed.load() : file.bad();
+    }
+    
+    // Все ли данные файла уже прочитаны
+    bool atEnd() {
+        return begin == end && !refill();
+    }
+    
+    // Выделяет следующую строку без завершающего '\n'. Последняя строка файла может
+    // не иметь '\n'. Строка действительна до следующего обращения к читателю
+    bool nextLine(std::string_view& line) {
+        size_t scanned = 0; // сколько байт от начала строки уже проверено
+        while (true) {
+            const char* data = buffer.data();
+            const void* newline = std::memchr(data + begin + scanned, '\n', end - begin - scanned);
+            if (newline) {
+                const size_t lineEnd = static_cast<const char*>(newline) - data;
+                line = std::string_view(data + begin, lineEnd - begin);
+                begin = lineEnd + 1;
+                return true;
+            }
+            
+            scanned = end - begin;
+            if (!refill()) {
+                if (begin == end) {
+                    return false;
+                }
+                line = std::string_view(buffer.data() + begin, end - begin);
+                begin = end;
+                return true;
+            }
+        }
+    }
+    
+    // Возвращает указатель на следующие size байт, расположенные в буфере подряд,
+    // и продвигает позицию чтения. nullptr - если файл закончился раньше.
+    // Данные действительны до следующего обращения к читателю
+    const char* take(size_t size) {
+        while (end - begin < size) {
+            if (!refill(size - (end - begin))) {
+                return nullptr;
+            }
+        }
+        const char* data = buffer.data() + begin;
+        begin += size;
+        return data;
+    }
+};
+
+// Блочная запись файла. Данные накапливаются в буфере и записываются крупными блоками;
+// ключи форматируются std::to_chars прямо в буфер.
+// При переданном IoExecutor заполненный блок записывается в фоне, а заполнение
+// продолжается во втором буфере
+class BlockWriter {
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    size_t used = 0;
+    
+    IoExecutor* const io;          // фоновые потоки или nullptr для синхронной записи
+    std::vector<char> spare;       // буфер, записываемый в фоне
+    std::future<size_t> pending;   // незавершенная фоновая запись
+    
+    // Наибольшее количество десятичных цифр в uint64_t
+    static constexpr size_t MAX_KEY_DIGITS = 20;
+    
+    void waitPending() {
+        if (pending.valid()) {
+            pending.get();
+        }
+    }
+    
+    void flush() {
+        if (!io) {
+            file.write(buffer.data(), used);
+            used = 0;
+            return;
+        }
+        waitPending();
+        spare.resize(buffer.size());
+        buffer.swap(spare);
+        const size_t size = used;
+        used = 0;
+        pending = io->submit([this, size] {
+            file.write(spare.data(), size);
+            return size;
+        });
+    }
+
+public:
+    BlockWriter(const std::string& path, size_t blockSize, IoExecutor* io = nullptr)
+        : buffer(blockSize), io(io) {
+        file.rdbuf()->pubsetbuf(nullptr, 0);
+        file.open(path, std::ios::binary | std::ios::trunc);
+    }
+    
+    // Фоновая операция обращается к полям писателя, поэтому ее нужно дождаться
+    ~BlockWriter() {
+        if (pending.valid()) {
+            pending.wait();
+        }
+    }
+    
+    // Позиция в существующем файле, с которой начинается запись
+    struct At {
+        uint64_t offset;
+    };
+    
+    // Открывает существующий файл без усечения и пишет в него начиная с позиции at
+    BlockWriter(const std::string& path, At at, size_t blockSize, IoExecutor* io = nullptr)
+        : buffer(blockSize), io(io) {
+        file.rdbuf()->pubsetbuf(nullptr, 0);
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+        if (file.is_open()) {
+            file.seekp(static_cast<std::streamoff>(at.offset));
+        }
+    }
+    
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+    
+    explicit operator bool() const {
+        return file.is_open();
+    }
+    
+    // Добавляет байты в выходной поток; крупные фрагменты записываются напрямую
+    void write(const char* data, size_t size) {
+        if (size > buffer.size() - used) {
+            flush();
+            if (size >= buffer.size()) {
+                waitPending();
+                file.write(data, size);
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+    
+    // Записывает текстовую строку результата вида <key>:<value>\n
+    void writeLine(uint64_t key, std::string_view value) {
+        const size_t maxSize = MAX_KEY_DIGITS + value.size() + 2;
+        if (maxSize > buffer.size() - used) {
+            flush();
+        }
+        if (maxSize > buffer.size()) {
+            char digits[MAX_KEY_DIGITS];
+            const char* digitsEnd = std::to_chars(digits, digits + MAX_KEY_DIGITS, key).ptr;
+            write(digits, digitsEnd - digits);
+            write(":", 1);
+            write(value.data(), value.size());
+            write("\n", 1);
+            return;
+        }
+        
+        char* out = buffer.data() + used;
+        out = std::to_chars(out, out + MAX_KEY_DIGITS, key).ptr;
+        *out++ = ':';
+        std::memcpy(out, value.data(), value.size());
+        out += value.size();
+        *out++ = '\n';
+        used = out - buffer.data();
+    }
+    
+    // Сбрасывает буфер и закрывает файл; возвращает false при ошибке записи.
+    // Без вызова close() данные из буфера не записываются
+    bool close() {
+        flush();
+        waitPending();
+        file.close();
+        return !file.fail();
+    }
+};
+
+// Формат записи временного файла: ключ (8 байт), длина значения (4 байта) и байты
+// значения. Временные файлы читает только эта же программа, поэтому числа
+// записываются в машинном порядке байтов
+void writeRunRecord(BlockWriter& output, uint64_t key, std::string_view value) {
+    const uint32_t length = static_cast<uint32_t>(value.size());
+    char header[sizeof(key) + sizeof(length)];
+    std::memcpy(header, &key, sizeof(key));
+    std::memcpy(header + sizeof(key), &length, sizeof(length));
+    output.write(header, sizeof(header));
+    output.write(value.data(), value.size());
+}
+
+// Размер записи временного файла в байтах
+uint64_t runRecordSize(std::string_view value) {
+    return sizeof(uint64_t) + sizeof(uint32_t) + value.size();
+}
+
+// Результат чтения записи временного файла
+enum class ReadStatus {
+    Ok,        // запись прочитана
+    End,       // достигнут конец файла
+    Corrupted  // файл обрывается посреди записи
+};
+
+// Читает запись временного файла в формате writeRunRecord.
+// Значение указывает в буфер читателя и действительно до следующего чтения
+ReadStatus readRunRecord(BlockReader& input, KeyValuePair& pair) {
+    if (input.atEnd()) {
+        return ReadStatus::End;
+    }
+    uint32_t length = 0;
+    const char* header = input.take(sizeof(pair.key) + sizeof(length));
+    if (!header) {
+        return ReadStatus::Corrupted;
+    }
+    std::memcpy(&pair.key, header, sizeof(pair.key));
+    std::memcpy(&length, header + sizeof(pair.key), sizeof(length));
+    
+    const char* value = input.take(length);
+    if (!value) {
+        return ReadStatus::Corrupted;
+    }
+    pair.value = std::string_view(value, length);
+    return ReadStatus::Ok;
+}
+
+// Формат временных файлов
+enum class SpillFormat {
+    Plain,  // ключ и длина фиксированного размера (writeRunRecord)
+    Compact // разности ключей и упакованные значения (writeCompactRecord)
+};
+
+// Алфавит упакованных значений: каждый символ занимает 6 бит
+constexpr char PACK_ALPHABET[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+
+// Таблица обратного преобразования алфавита: код символа или -1
+const int8_t* packCodes() {
+    static const auto codes = [] {
+        std::array<int8_t, 256> table;
+        table.fill(-1);
+        for (size_t i = 0; i + 1 < sizeof(PACK_ALPHABET); ++i) {
+            table[static_cast<unsigned char>(PACK_ALPHABET[i])] = static_cast<int8_t>(i);
+        }
+        return table;
+    }();
+    return codes.data();
+}
+
+// Размер упакованного значения из length символов
+size_t packedSize(size_t length) {
+    return (length * 6 + 7) / 8;
+}
+
+// Записывает число кодом переменной длины (по 7 бит в байте, младшие вперед);
+// возвращает количество записанных байт
+size_t writeVarint(BlockWriter& output, uint64_t value) {
+    char bytes[10];
+    size_t count = 0;
+    while (value >= 0x80) {
+        bytes[count++] = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    bytes[count++] = static_cast<char>(value);
+    output.write(bytes, count);
+    return count;
+}
+
+// Читает число, записанное writeVarint; size увеличивается на число прочитанных байт
+bool readVarint(BlockReader& input, uint64_t& value, uint64_t& size) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const char* byte = input.take(1);
+        if (!byte) {
+            return false;
+        }
+        size++;
+        const uint64_t bits = static_cast<unsigned char>(*byte);
+        value |= (bits & 0x7F) << shift;
+        if ((bits & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Записывает запись временного файла в сжатом виде: разность ключа с ключом
+// предыдущей записи (previousKey, ключи в файле не убывают), длину значения
+// с признаком упаковки в младшем бите и само значение. Значение, все символы
+// которого входят в PACK_ALPHABET, упаковывается по 6 бит на символ в буфер packed.
+// Возвращает размер записи в байтах
+uint64_t writeCompactRecord(BlockWriter& output, uint64_t key, uint64_t previousKey,
+                            std::string_view value, std::string& packed) {
+    const int8_t* codes = packCodes();
+    bool packable = true;
+    for (const char c : value) {
+        if (codes[static_cast<unsigned char>(c)] < 0) {
+            packable = false;
+            break;
+        }
+    }
+    
+    uint64_t size = writeVarint(output, key - previousKey);
+    size += writeVarint(output, (uint64_t(value.size()) << 1) | (packable ? 1 : 0));
+    if (!packable) {
+        output.write(value.data(), value.size());
+        return size + value.size();
+    }
+    
+    packed.clear();
+    uint32_t bits = 0;
+    unsigned bitCount = 0;
+    for (const char c : value) {
+        bits = (bits << 6) | static_cast<uint32_t>(codes[static_cast<unsigned char>(c)]);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            packed.push_back(static_cast<char>(bits >> bitCount));
+        }
+    }
+    if (bitCount > 0) {
+        packed.push_back(static_cast<char>(bits << (8 - bitCount)));
+    }
+    output.write(packed.data(), packed.size());
+    return size + packed.size();
+}
+
+// Читает запись в формате writeCompactRecord. previousKey - ключ предыдущей записи;
+// упакованное значение распаковывается в буфер unpacked. size увеличивается на размер записи
+ReadStatus readCompactRecord(BlockReader& input, uint64_t previousKey, KeyValuePair& pair,
+                             std::string& unpacked, uint64_t& size) {
+    if (input.atEnd()) {
+        return ReadStatus::End;
+    }
+    uint64_t delta = 0;
+    uint64_t header = 0;
+    if (!readVarint(input, delta, size) || !readVarint(input, header, size) || (header >> 1) > UINT32_MAX) {
+        return ReadStatus::Corrupted;
+    }
+    pair.key = previousKey + delta;
+    const size_t length = static_cast<size_t>(header >> 1);
+    
+    if ((header & 1) == 0) {
+        const char* value = input.take(length);
+        if (!value) {
+            return ReadStatus::Corrupted;
+        }
+        size += length;
+        pair.value = std::string_view(value, length);
+        return ReadStatus::Ok;
+    }
+    
+    const size_t byteCount = packedSize(length);
+    const char* packed = input.take(byteCount);
+    if (!packed) {
+        return ReadStatus::Corrupted;
+    }
+    size += byteCount;
+    unpacked.resize(length);
+    uint32_t bits = 0;
+    unsigned bitCount = 0;
+    for (size_t i = 0, next = 0; i < length; ++i) {
+        if (bitCount < 6) {
+            bits = (bits << 8) | static_cast<unsigned char>(packed[next++]);
+            bitCount += 8;
+        }
+        bitCount -= 6;
+        unpacked[i] = PACK_ALPHABET[(bits >> bitCount) & 0x3F];
+    }
+    pair.value = unpacked;
+    return ReadStatus::Ok;
+}
+
+// Количество десятичных цифр числа
+size_t decimalDigits(uint64_t value) {
+    size_t digits = 1;
+    for (uint64_t bound = 10; digits < 20 && value >= bound; bound *= 10) {
+        digits++;
+    }
+    return digits;
+}
+
+// Накопительная контрольная сумма байт: слово за словом с перемешиванием умножением.
+// Защищает от повреждения и подмены файлов, но не является криптографической
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+    const char* bytes = static_cast<const char*>(data);
+    auto mix = [&hash](uint64_t word) {
+        hash = (hash ^ word) * MULTIPLIER;
+        hash ^= hash >> 29;
+    };
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        mix(word);
+    }
+    // Хвост короче слова дополняется длиной, чтобы различались значения разной длины
+    uint64_t tail = size;
+    for (; i < size; ++i) {
+        tail = (tail << 8) | static_cast<unsigned char>(bytes[i]);
+    }
+    mix(tail);
+    return hash;
+}
+
+// Контрольная сумма записи временного файла, накапливаемая по всем его записям
+uint64_t hashRecord(uint64_t hash, uint64_t key, std::string_view value) {
+    return hashBytes(hashBytes(hash, &key, sizeof(key)), value.data(), value.size());
+}
+
+// Позиция во временном файле: смещение записи в файле и объем текста
+// результата, приходящийся на все предыдущие записи
+struct RunPosition {
+    uint64_t offset = 0;
+    uint64_t textOffset = 0;
+    uint64_t previousKey = 0; // ключ предыдущей записи - основа разностей ключей формата Compact
+};
+
+// Опорная точка разреженного индекса временного файла
+struct RunIndexEntry {
+    uint64_t key;
+    RunPosition position;
+};
+
+// Сведения о временном файле
+struct RunInfo {
+    std::string path;
+    uint64_t records = 0;
+    RunPosition end;                  // размер файла и объем текста всех его записей
+    std::vector<RunIndexEntry> index; // позиции каждой RUN_INDEX_INTERVAL-й записи
+    uint64_t lastKey = 0;             // ключ последней записи
+    uint64_t checksum = 0;            // контрольная сумма записей (только с --manifest)
+    uint64_t inputEnd = 0;            // граница во входном файле: все строки до нее находятся
+                                      // в этом и предыдущих файлах (0 - файл не на границе)
+    uint64_t inputSample = 0;         // контрольная сумма входного файла перед inputEnd
+    
+    // Учитывает очередную запись размером size байт, которой соответствует
+    // textSize байт результата
+    void add(uint64_t key, uint64_t size, uint64_t textSize);
+};
+
+// Диапазон байт временного файла, участвующий в слиянии
+struct RunRange {
+    const std::string* path;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t previousKey; // ключ записи перед началом диапазона
+};
+
+// Шаг разреженного индекса временных файлов (в записях)
+constexpr uint64_t RUN_INDEX_INTERVAL = 4096;
+
+void RunInfo::add(uint64_t key, uint64_t size, uint64_t textSize) {
+    if (records % RUN_INDEX_INTERVAL == 0) {
+        index.push_back({key, end});
+    }
+    end.offset += size;
+    records++;
+    end.textOffset += textSize;
+    end.previousKey = key;
+    lastKey = key;
+}
+
+// Запись временного файла с построением его разреженного индекса. Ключи индекса
+// служат выборкой для разбиения слияния на диапазоны, а позиции - для поиска
+// границ диапазонов и смещений их текста в файле результата. Опорная точка хранит
+// и ключ предыдущей записи, поэтому чтение формата Compact можно начать с любой из них
+class RunWriter {
+private:
+    BlockWriter output;
+    SpillFormat format;
+    bool checksummed;   // накапливать контрольную сумму записей
+    RunInfo info;
+    std::string packed; // буфер упаковки значений
+
+public:
+    RunWriter(const std::string& path, SpillFormat format, size_t blockSize, IoExecutor* io, bool checksummed)
+        : output(path, blockSize, io), format(format), checksummed(checksummed) {
+        info.path = path;
+    }
+    
+    explicit operator bool() const {
+        return static_cast<bool>(output);
+    }
+    
+    // textSize - объем строки результата, соответствующей записи
+    void write(uint64_t key, std::string_view value, uint64_t textSize) {
+        uint64_t size;
+        if (format == SpillFormat::Compact) {
+            size = writeCompactRecord(output, key, info.end.previousKey, value, packed);
+        } else {
+            writeRunRecord(output, key, value);
+            size = runRecordSize(value);
+        }
+        if (checksummed) {
+            info.checksum = hashRecord(info.checksum, key, value);
+        }
+        info.add(key, size, textSize);
+    }
+    
+    // Закрывает файл; возвращает false при ошибке записи
+    bool close() {
+        return output.close();
+    }
+    
+    // Сведения о записанном файле
+    RunInfo& result() {
+        return info;
+    }
+};
+
+// Последовательное чтение записей диапазона временного файла в любом формате
+class RunReader {
+private:
+    BlockReader file;
+    SpillFormat format;
+    uint64_t previousKey;
+    uint64_t recordSize = 0; // размер последней прочитанной записи в байтах
+    std::string unpacked;    // распакованное значение
+
+public:
+    RunReader(const RunRange& range, SpillFormat format, size_t blockSize, IoExecutor* io)
+        : file(*range.path, blockSize, io, range.begin, range.end - range.begin),
+          format(format), previousKey(range.previousKey) {}
+    
+    explicit operator bool() const {
+        return static_cast<bool>(file);
+    }
+    
+    // Произошла ли ошибка чтения
+    bool failed() const {
+        return file.failed();
+    }
+    
+    // Читает следующую запись; значение действительно до следующего чтения
+    ReadStatus next(KeyValuePair& pair) {
+        ReadStatus status;
+        if (format == SpillFormat::Compact) {
+            recordSize = 0;
+            status = readCompactRecord(file, previousKey, pair, unpacked, recordSize);
+        } else {
+            status = readRunRecord(file, pair);
+            recordSize = runRecordSize(pair.value);
+        }
+        previousKey = pair.key;
+        return status;
+    }
+    
+    // Размер последней прочитанной записи в байтах
+    uint64_t lastSize() const {
+        return recordSize;
+    }
+};
+
+// Компактная запись пакета: значение хранится в общей области памяти пакета
+struct BatchRecord {
+    uint64_t key;    // ключ
+    uint32_t offset; // смещение значения в тексте пакета
+    uint32_t length; // длина значения
+};
+
+// Запись стратегии Keys: ключ и положение значения во входном файле
+struct KeyLocator {
+    uint64_t key;    // ключ
+    uint64_t offset; // смещение значения во входном файле
+    uint32_t length; // длина значения
+};
+
+// Размер положения значения, записываемого во временный файл вместо самого значения
+constexpr size_t LOCATOR_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+
+// Записывает положение значения в буфер bytes размером LOCATOR_SIZE
+std::string_view encodeLocator(const KeyLocator& locator, char* bytes) {
+    std::memcpy(bytes, &locator.offset, sizeof(locator.offset));
+    std::memcpy(bytes + sizeof(locator.offset), &locator.length, sizeof(locator.length));
+    return std::string_view(bytes, LOCATOR_SIZE);
+}
+
+// Разбирает положение значения, записанное encodeLocator
+bool decodeLocator(std::string_view bytes, KeyLocator& locator) {
+    if (bytes.size() != LOCATOR_SIZE) {
+        return false;
+    }
+    std::memcpy(&locator.offset, bytes.data(), sizeof(locator.offset));
+    std::memcpy(&locator.length, bytes.data() + sizeof(locator.offset), sizeof(locator.length));
+    return true;
+}
+
+// Устойчивая поразрядная сортировка LSD записей по 64-битному ключу.
+// Гистограммы всех восьми байтовых разрядов строятся за один проход; разряды,
+// в которых все ключи совпадают, пропускаются
+template <typename Record>
+void radixSortByKey(std::vector<Record>& records) {
+    constexpr size_t DIGITS = sizeof(uint64_t);
+    constexpr size_t RADIX = 256;
+    const size_t count = records.size();
+    
+    std::vector<size_t> histogram(DIGITS * RADIX, 0);
+    for (const auto& record : records) {
+        for (size_t digit = 0; digit < DIGITS; ++digit) {
+            histogram[digit * RADIX + ((record.key >> (digit * 8)) & 0xFF)]++;
+        }
+    }
+    
+    std::vector<Record> buffer;
+    for (size_t digit = 0; digit < DIGITS; ++digit) {
+        size_t* counts = histogram.data() + digit * RADIX;
+        const unsigned firstByte = (records.front().key >> (digit * 8)) & 0xFF;
+        if (counts[firstByte] == count) {
+            continue; // Во всех ключах этот байт одинаков
+        }
+        
+        // Преобразуем счетчики в начальные позиции корзин
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX; ++bucket) {
+            const size_t bucketSize = counts[bucket];
+            counts[bucket] = offset;
+            offset += bucketSize;
+        }
+        
+        if (buffer.empty()) {
+            buffer.resize(count);
+        }
+        for (const auto& record : records) {
+            buffer[counts[(record.key >> (digit * 8)) & 0xFF]++] = record;
+        }
+        records.swap(buffer);
+    }
+}
+
+// Устойчивая сортировка подсчетом для пакетов с небольшим числом различных ключей:
+// различные ключи собираются в хеш-таблицу, упорядочиваются, и записи за один
+// проход раскладываются по своим участкам. Возвращает false, не изменяя записи,
+// если различных ключей больше maxDistinct
+template <typename Record>
+bool countingSortByKey(std::vector<Record>& records, size_t maxDistinct) {
+    // Открытая адресация; таблица заполнена не больше чем наполовину
+    size_t tableSize = 1;
+    while (tableSize < 2 * maxDistinct) {
+        tableSize *= 2;
+    }
+    constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<uint32_t> table(tableSize, EMPTY); // номер ключа в distinct
+    std::vector<uint64_t> distinct;
+    std::vector<size_t> counts;
+    
+    auto find = [&](uint64_t key) -> uint32_t& {
+        size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (tableSize - 1);
+        while (table[slot] != EMPTY && distinct[table[slot]] != key) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        return table[slot];
+    };
+    
+    for (const auto& record : records) {
+        uint32_t& bucket = find(record.key);
+        if (bucket == EMPTY) {
+            if (distinct.size() == maxDistinct) {
+                return false;
+            }
+            bucket = static_cast<uint32_t>(distinct.size());
+            distinct.push_back(record.key);
+            counts.push_back(0);
+        }
+        counts[bucket]++;
+    }
+    
+    // Начала участков в порядке возрастания ключей
+    std::vector<uint32_t> order(distinct.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&distinct](uint32_t a, uint32_t b) { return distinct[a] < distinct[b]; });
+    std::vector<size_t> starts(distinct.size());
+    size_t offset = 0;
+    for (const uint32_t bucket : order) {
+        starts[bucket] = offset;
+        offset += counts[bucket];
+    }
+    
+    std::vector<Record> buffer(records.size());
+    for (const auto& record : records) {
+        buffer[starts[find(record.key)]++] = record;
+    }
+    records.swap(buffer);
+    return true;
+}
+
+// Алгоритм сортировки пакетов в памяти
+enum class SortEngine {
+    Radix,  // поразрядная сортировка LSD
+    Stable  // std::stable_sort
+};
+
+// Стратегия сортировки
+enum class SortStrategy {
+    Auto,    // выбор по средней длине строки
+    Records, // строки целиком проходят через пакеты и временные файлы
+    Keys     // сортируются только ключи с положениями значений, значения читаются при выводе
+};
+
+// Способ формирования временных файлов
+enum class RunFormation {
+    Batches,    // пакеты по бюджету памяти сортируются целиком, параллельно
+    Replacement // выбор с заменой: куча в пределах лимита, файлы в среднем вдвое длиннее
+};
+
+// Вывод статистики выполнения
+enum class StatsFormat {
+    None, // не выводится
+    Text, // человекочитаемый отчет в стандартный вывод
+    Json  // одна строка JSON в стандартный поток ошибок
+};
+
+// Параметры сортировки, задаваемые из командной строки
+struct SortOptions {
+    size_t threads = 0;                   // количество потоков сортировки пакетов (0 - по числу ядер)
+    size_t memoryLimit = size_t(1) << 30; // предельный объем оперативной памяти в байтах
+    SortEngine engine = SortEngine::Radix; // алгоритм сортировки пакетов
+    bool asyncIo = false;                 // упреждающее чтение и фоновая запись
+    size_t fanIn = 0;                     // наибольшая ширина слияния (0 - по умолчанию)
+    SpillFormat spillFormat = SpillFormat::Plain; // формат временных файлов
+    SortStrategy strategy = SortStrategy::Auto;   // стратегия сортировки
+    RunFormation runFormation = RunFormation::Batches; // формирование временных файлов
+    StatsFormat stats = StatsFormat::None;        // вывод статистики выполнения
+    std::vector<std::string> tempDirs;            // каталоги временных файлов (пусто - рядом с результатом)
+    std::string manifestPath;                     // манифест для возобновления сортировки (пусто - без него)
+    bool keepRuns = false;                        // сохранять временные файлы и манифест после сортировки
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Время, прошедшее с момента start, в наносекундах
+uint64_t elapsedNanos(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Статистика выполнения сортировки. Счетчики, которые обновляют потоки сортировки
+// и слияния, атомарны; время их этапов суммируется по всем потокам
+struct SortStats {
+    const char* strategy = "records";          // выбранная стратегия
+    const char* runFormation = "batches";      // способ формирования временных файлов
+    bool inMemory = false;                     // сортировка без временных файлов
+    std::atomic<uint64_t> inputBytes{0};       // прочитано из входного файла
+    std::atomic<uint64_t> records{0};          // разобранных записей
+    std::atomic<uint64_t> rejectedLines{0};    // строк, которые не удалось разобрать
+    std::atomic<uint64_t> peakBatchMemory{0};  // наибольшая память одного пакета
+    std::atomic<uint64_t> presortedBatches{0}; // пакетов, упорядоченных без полной сортировки
+    std::atomic<uint64_t> countedBatches{0};   // пакетов, отсортированных подсчетом
+    std::atomic<uint64_t> spilledBytes{0};     // записано во временные файлы за все проходы
+    std::atomic<uint64_t> mergeReadBytes{0};   // прочитано из временных файлов при слияниях
+    uint64_t outputBytes = 0;                  // размер файла результата
+    size_t runs = 0;                           // временных файлов после формирования пакетов
+    size_t mergePasses = 0;                    // проходов слияния
+    size_t fanIn = 0;                          // наибольшая ширина слияния
+    size_t partitions = 0;                     // диапазонов последнего прохода
+    std::atomic<uint64_t> parseNanos{0};       // разбор строк (сумма по потокам)
+    std::atomic<uint64_t> sortNanos{0};        // сортировка пакетов (сумма по потокам)
+    std::atomic<uint64_t> spillNanos{0};       // запись пакетов (сумма по потокам)
+    uint64_t runFormationNanos = 0;            // этап формирования пакетов целиком
+    uint64_t mergeNanos = 0;                   // промежуточные проходы слияния
+    uint64_t finalMergeNanos = 0;              // последний проход слияния
+    uint64_t totalNanos = 0;                   // вся сортировка
+};
+
+// Атомарно увеличивает value до candidate, если candidate больше
+void updateMax(std::atomic<uint64_t>& value, uint64_t candidate) {
+    uint64_t current = value.load();
+    while (current < candidate && !value.compare_exchange_weak(current, candidate)) {
+    }
+}
+
+// Формирует человекочитаемый отчет по статистике
+std::string formatStats(const SortStats& stats) {
+    const double seconds = 1e-9;
+    const double total = stats.totalNanos * seconds;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "Статистика сортировки:\n";
+    out << "  стратегия: " << stats.strategy << ", формирование временных файлов: " << stats.runFormation
+        << (stats.inMemory ? ", без временных файлов" : "") << "\n";
+    out << "  всего: " << total << " с, " << std::setprecision(0)
+        << (total > 0 ? stats.records / total : 0.0) << " записей/с, "
+        << (total > 0 ? stats.inputBytes / total / (1 << 20) : 0.0) << " МиБ/с" << std::setprecision(3) << "\n";
+    out << "  формирование пакетов: " << stats.runFormationNanos * seconds << " с (по потокам: разбор "
+        << stats.parseNanos * seconds << " с, сортировка " << stats.sortNanos * seconds << " с, запись "
+        << stats.spillNanos * seconds << " с)\n";
+    out << "  слияние: промежуточные проходы " << stats.mergeNanos * seconds << " с, последний проход "
+        << stats.finalMergeNanos * seconds << " с\n";
+    out << "  записей: " << stats.records << ", неразобранных строк: " << stats.rejectedLines << "\n";
+    out << "  временных файлов: " << stats.runs << ", проходов слияния: " << stats.mergePasses
+        << ", файлов в слиянии до " << stats.fanIn << ", диапазонов последнего прохода: " << stats.partitions << "\n";
+    out << "  наибольшая память пакета: " << stats.peakBatchMemory << " байт; пакетов почти упорядоченных: "
+        << stats.presortedBatches << ", отсортированных подсчетом: " << stats.countedBatches << "\n";
+    out << "  прочитано из входного файла: " << stats.inputBytes << " байт, записано в результат: "
+        << stats.outputBytes << " байт\n";
+    out << "  записано во временные файлы: " << stats.spilledBytes << " байт, прочитано из них: "
+        << stats.mergeReadBytes << " байт\n";
+    return out.str();
+}
+
+// Формирует статистику одной строкой JSON
+std::string formatStatsJson(const SortStats& stats) {
+    const double seconds = 1e-9;
+    const double total = stats.totalNanos * seconds;
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(6);
+    out << "{\"strategy\":\"" << stats.strategy << "\""
+        << ",\"run_formation\":\"" << stats.runFormation << "\""
+        << ",\"in_memory\":" << (stats.inMemory ? "true" : "false")
+        << ",\"total_seconds\":" << total
+        << ",\"run_formation_seconds\":" << stats.runFormationNanos * seconds
+        << ",\"parse_seconds\":" << stats.parseNanos * seconds
+        << ",\"sort_seconds\":" << stats.sortNanos * seconds
+        << ",\"spill_seconds\":" << stats.spillNanos * seconds
+        << ",\"merge_seconds\":" << stats.mergeNanos * seconds
+        << ",\"final_merge_seconds\":" << stats.finalMergeNanos * seconds
+        << ",\"records\":" << stats.records
+        << ",\"records_per_second\":" << (total > 0 ? stats.records / total : 0.0)
+        << ",\"rejected_lines\":" << stats.rejectedLines
+        << ",\"runs\":" << stats.runs
+        << ",\"merge_passes\":" << stats.mergePasses
+        << ",\"fan_in\":" << stats.fanIn
+        << ",\"partitions\":" << stats.partitions
+        << ",\"peak_batch_memory\":" << stats.peakBatchMemory
+        << ",\"presorted_batches\":" << stats.presortedBatches
+        << ",\"counted_batches\":" << stats.countedBatches
+        << ",\"input_bytes\":" << stats.inputBytes
+        << ",\"output_bytes\":" << stats.outputBytes
+        << ",\"spilled_bytes\":" << stats.spilledBytes
+        << ",\"merge_read_bytes\":" << stats.mergeReadBytes
+        << "}\n";
+    return out.str();
+}
+
+// Ограниченная очередь для передачи данных между потоками
+template <typename T>
+class BoundedQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    const size_t capacity;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    // Помещает элемент в очередь, ожидая освобождения места
+    void push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    // Извлекает элемент из очереди; возвращает false, если очередь закрыта и пуста
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Сообщает потребителям, что новых элементов не будет
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+// Турнирное дерево проигравших для многопутевого слияния.
+// Хранит номера источников; less(a, b) сравнивает текущие элементы источников a и b
+// и должен задавать строгий полный порядок (исчерпанные источники - больше любых других).
+// Выбор минимума и замена элемента выполняются за O(log k) сравнений
+template <typename Less>
+class LoserTree {
+private:
+    std::vector<size_t> tree; // tree[0] - победитель, tree[1..k-1] - проигравшие во внутренних узлах
+    const size_t count;
+    Less less;
+    
+    // Номер count обозначает фиктивный источник, меньший любого настоящего
+    bool isLess(size_t a, size_t b) const {
+        if (a == count) return true;
+        if (b == count) return false;
+        return less(a, b);
+    }
+    
+    // Проводит источник от листа до корня, оставляя в узлах проигравших
+    void adjust(size_t source) {
+        size_t winner = source;
+        for (size_t node = (source + count) / 2; node > 0; node /= 2) {
+            if (isLess(tree[node], winner)) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+public:
+    LoserTree(size_t count, Less less) : tree(count, count), count(count), less(less) {
+        for (size_t i = count; i > 0; --i) {
+            adjust(i - 1);
+        }
+    }
+    
+    // Источник с минимальным текущим элементом
+    size_t top() const {
+        return tree[0];
+    }
+    
+    // Восстанавливает дерево после продвижения источника-победителя
+    void replay() {
+        adjust(tree[0]);
+    }
+};
+
+// План многопроходного слияния временных файлов
+struct MergePlan {
+    size_t runs = 0;      // количество временных файлов после формирования пакетов
+    size_t passes = 0;    // количество проходов слияния
+    size_t fanIn = 0;     // наибольшее количество файлов в одном слиянии
+    size_t blockSize = 0; // размер блока чтения каждого файла
+};
+
+// Порция сырых строк, передаваемая от потока чтения потокам сортировки
+struct RawBatch {
+    size_t index = 0;     // номер пакета (он же номер временного файла)
+    size_t lineCount = 0; // количество строк в пакете
+    std::string text;     // строки пакета подряд, каждая завершена символом '\n'
+    std::vector<KeyLocator> locators; // ключи и положения значений (стратегия Keys)
+    bool complete = false; // пакет содержит весь входной файл
+    uint64_t inputEnd = 0; // смещение во входном файле за последней строкой пакета
+};
+
+// Состояние последовательного чтения входного файла пакетами
+struct InputCursor {
+    BlockReader file;
+    std::string pendingLine;     // строка, не поместившаяся в предыдущий пакет
+    bool hasPendingLine = false;
+    uint64_t offset;             // смещение следующей строки в файле
+    
+    // Чтение начинается с позиции offset: при возобновлении по манифесту
+    // уже обработанная часть файла пропускается
+    InputCursor(const std::string& path, size_t blockSize, IoExecutor* io, uint64_t offset = 0)
+        : file(path, blockSize, io, offset), offset(offset) {}
+    
+    // Проверяет, прочитан ли файл до конца
+    bool exhausted() {
+        return !hasPendingLine && file.atEnd();
+    }
+};
+
+// Запись кучи выбора с заменой. Номер временного файла - старшая часть порядка
+// записей, порядковый номер строки - младшая: он сохраняет устойчивость равных ключей
+struct SelectionRecord {
+    size_t run = 0;        // номер временного файла, в который попадет запись
+    uint64_t key = 0;
+    uint64_t sequence = 0; // номер строки во входном файле
+    std::string value;     // значение (в стратегии Keys - положение значения)
+};
+
+// Вывод результата стратегии Keys: значения читаются из входного файла по их
+// положениям. Строки накапливаются порциями в пределах бюджета памяти; значения
+// порции читаются в порядке смещений, соседние значения - одним крупным чтением
+// вместе с промежутками до MAX_GATHER_GAP байт, затем строки пишутся в порядке ключей
+class ValueGatherer {
+private:
+    // Наибольший промежуток между значениями, который выгоднее прочитать, чем пропустить
+    static constexpr uint64_t MAX_GATHER_GAP = uint64_t(64) << 10;
+    
+    std::ifstream input;
+    BlockWriter& output;
+    std::vector<KeyLocator> lines;   // строки порции в порядке вывода
+    std::vector<uint64_t> targets;   // смещения значений в области values
+    std::vector<size_t> order;       // номера строк в порядке смещений значений
+    std::string values;              // значения порции
+    std::vector<char> readBuffer;    // буфер объединенного чтения
+    size_t memoryBudget;             // бюджет памяти порции без буфера чтения
+    size_t usedMemory = 0;
+    bool readFailed = false;
+    
+    // Память строки порции: положение, смещение в области значений, номер и само значение
+    static size_t lineMemory(const KeyLocator& line) {
+        return sizeof(KeyLocator) + sizeof(uint64_t) + sizeof(size_t) + line.length;
+    }
+    
+    // Читает length байт входного файла с позиции offset
+    bool readAt(uint64_t offset, char* data, size_t length) {
+        input.seekg(static_cast<std::streamoff>(offset));
+        input.read(data, static_cast<std::streamsize>(length));
+        return static_cast<size_t>(input.gcount()) == length;
+    }
+    
+    // Читает значения порции и записывает ее строки
+    void flush() {
+        uint64_t valueBytes = 0;
+        targets.resize(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            targets[i] = valueBytes;
+            valueBytes += lines[i].length;
+        }
+        values.resize(valueBytes);
+        
+        order.resize(lines.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(),
+                  [this](size_t a, size_t b) { return lines[a].offset < lines[b].offset; });
+        
+        for (size_t first = 0; first < order.size() && !readFailed;) {
+            const KeyLocator& head = lines[order[first]];
+            if (head.length >= readBuffer.size()) {
+                // Длинное значение читается сразу на место
+                readFailed = !readAt(head.offset, values.data() + targets[order[first]], head.length);
+                first++;
+                continue;
+            }
+            
+            // Расширяем чтение, пока промежутки малы и данные помещаются в буфер
+            const uint64_t spanBegin = head.offset;
+            uint64_t spanEnd = head.offset + head.length;
+            size_t last = first + 1;
+            while (last < order.size()) {
+                const KeyLocator& next = lines[order[last]];
+                const uint64_t nextEnd = next.offset + next.length;
+                if (next.offset > spanEnd + MAX_GATHER_GAP || nextEnd - spanBegin > readBuffer.size()) {
+                    break;
+                }
+                spanEnd = nextEnd;
+                last++;
+            }
+            
+            readFailed = !readAt(spanBegin, readBuffer.data(), spanEnd - spanBegin);
+            for (size_t i = first; i < last; ++i) {
+                const KeyLocator& line = lines[order[i]];
+                std::memcpy(values.data() + targets[order[i]], readBuffer.data() + (line.offset - spanBegin), line.length);
+            }
+            first = last;
+        }
+        
+        if (!readFailed) {
+            for (size_t i = 0; i < lines.size(); ++i) {
+                output.writeLine(lines[i].key, std::string_view(values.data() + targets[i], lines[i].length));
+            }
+        }
+        lines.clear();
+        usedMemory = 0;
+    }
+
+public:
+    // memory - бюджет памяти; четверть его, но не больше maxRead, отводится под буфер чтения
+    // Емкость массивов порции выделяется заранее на наибольшее число строк: иначе
+    // при их росте вдвое занятая память могла бы превысить бюджет
+    ValueGatherer(const std::string& inputPath, BlockWriter& output, size_t memory, size_t maxRead)
+        : output(output), readBuffer(std::min(memory / 4, maxRead)), memoryBudget(memory - readBuffer.size()) {
+        const size_t maxLines = memoryBudget / lineMemory(KeyLocator{0, 0, 0}) + 1;
+        lines.reserve(maxLines);
+        targets.reserve(maxLines);
+        order.reserve(maxLines);
+        values.reserve(memoryBudget);
+        input.rdbuf()->pubsetbuf(nullptr, 0);
+        input.open(inputPath, std::ios::binary);
+    }
+    
+    ValueGatherer(const ValueGatherer&) = delete;
+    ValueGatherer& operator=(const ValueGatherer&) = delete;
+    
+    explicit operator bool() const {
+        return input.is_open();
+    }
+    
+    // Добавляет строку результата
+    void add(const KeyLocator& line) {
+        if (!lines.empty() && usedMemory + lineMemory(line) > memoryBudget) {
+            flush();
+        }
+        lines.push_back(line);
+        usedMemory += lineMemory(line);
+    }
+    
+    // Записывает оставшиеся строки; возвращает false, если значения не удалось прочитать
+    bool finish() {
+        if (!lines.empty()) {
+            flush();
+        }
+        return !readFailed;
+    }
+};
+
+// Класс для пакетной обработки файла
+class FileSorter {
+private:
+    const std::string inputPath;
+    const std::string outputPath;
+    const SortOptions options;
+    
+    // Границы размера блока файлового ввода-вывода
+    static constexpr size_t MIN_IO_BLOCK = size_t(8) << 10;
+    static constexpr size_t MAX_IO_BLOCK = size_t(4) << 20;
+    
+    // Пакеты меньшего размера сортируются std::stable_sort и при выборе поразрядной сортировки
+    static constexpr size_t MIN_RADIX_SORT_SIZE = 256;
+    
+    // Наибольшее число возрастающих участков пакета, которые выгоднее слить
+    // попарно, чем сортировать пакет заново
+    static constexpr size_t MAX_PRESORTED_STRETCHES = 16;
+    
+    // Наибольшее число различных ключей пакета для сортировки подсчетом
+    static constexpr size_t MAX_COUNTED_KEYS = 1024;
+    
+    // Минимальный бюджет памяти одного пакета
+    static constexpr size_t MIN_BATCH_MEMORY = size_t(1) << 20;
+    
+    // Начальная емкость текста пакета
+    static constexpr size_t INITIAL_BATCH_TEXT = size_t(1) << 16;
+    
+    // Предельный размер текста пакета: смещения значений хранятся в 32 битах
+    static constexpr size_t MAX_BATCH_TEXT = UINT32_MAX;
+    
+    // Память, которую строка займет на всех этапах обработки пакета, кроме самого
+    // текста пакета: запись в массиве сортировки и во вспомогательном буфере сортировки.
+    // Значения не копируются - записи указывают прямо в текст пакета
+    static size_t lineMemory(std::string_view) {
+        return 2 * sizeof(BatchRecord);
+    }
+    
+    // Служебные данные распределителя памяти на один блок кучи
+    static constexpr size_t ALLOCATION_OVERHEAD = 2 * sizeof(void*);
+    
+    // Наибольшая ширина слияния по умолчанию: ограничивает число одновременно открытых файлов
+    static constexpr size_t DEFAULT_MAX_FAN_IN = 256;
+    
+    // Желательный размер буфера чтения при слиянии: крупные последовательные чтения
+    // важнее ширины слияния, особенно на вращающихся дисках
+    static constexpr size_t PREFERRED_MERGE_BLOCK = size_t(1) << 20;
+    
+    // Память самого процесса, не подчиненная бюджетам этапов: исполняемый файл,
+    // библиотека C++ и стеки потоков. Она вычитается из лимита заранее
+    static constexpr size_t PROCESS_MEMORY = size_t(4) << 20;
+    
+    // Буферам слияния отводится 1/MERGE_BUFFER_SHARE лимита памяти (см. mergeMemory)
+    static constexpr size_t MERGE_BUFFER_SHARE = 4;
+    
+    // Память одного сливаемого файла помимо буферов: читатель, его текущая запись
+    // и узел дерева проигравших
+    static constexpr size_t MERGE_STREAM_MEMORY = sizeof(RunReader) + sizeof(KeyValuePair) + 2 * sizeof(size_t);
+    
+    // Количество фоновых потоков ввода-вывода: чтение и запись не ждут друг друга
+    static constexpr size_t IO_THREADS = 2;
+    
+    // Наименьший буфер чтения одного файла при параллельном последнем проходе: от
+    // него зависит, на сколько диапазонов можно разбить слияние при заданном лимите
+    static constexpr size_t MIN_PARTITION_BLOCK = size_t(256) << 10;
+    
+    // Наименьшее среднее число записей в диапазоне параллельного слияния: на меньших
+    // объемах поиск границ и запуск потоков не окупаются
+    static constexpr uint64_t MIN_PARTITION_RECORDS = 16 * RUN_INDEX_INTERVAL;
+    
+    // Средняя длина строки, начиная с которой --strategy=auto выбирает стратегию Keys:
+    // перемещение длинных значений через пакеты и слияние обходится дороже
+    // их выборочного чтения при выводе
+    static constexpr uint64_t KEY_STRATEGY_MIN_LINE = 256;
+    
+    // Объем начала входного файла, по которому оценивается средняя длина строки
+    static constexpr uint64_t STRATEGY_SAMPLE = uint64_t(1) << 20;
+    
+    // Объем входного файла перед границей временного файла, по контрольной сумме
+    // которого при возобновлении проверяется, что входной файл не изменился
+    static constexpr uint64_t MANIFEST_SAMPLE = uint64_t(64) << 10;
+    
+    // Сколько номеров временных файлов резервирует одна запись манифеста: номер
+    // каждого созданного файла меньше записанного в манифест, а перезапись ради
+    // резерва нужна не чаще чем через столько файлов
+    static constexpr size_t TEMP_NUMBER_RESERVE = 64;
+    
+    // Первая строка манифеста: формат файла и его версия
+    static constexpr const char* MANIFEST_HEADER = "sort_bigdatafile manifest 1";
+    
+    // Фоновые потоки ввода-вывода (только в режиме --async-io)
+    std::unique_ptr<IoExecutor> io;
+    
+    // Сведения о временных файлах в порядке их номеров
+    std::vector<RunInfo> runs;
+    std::mutex runsMutex;
+    
+    // Имена всех созданных временных файлов: при ошибке удаляются оставшиеся из них
+    std::vector<std::string> tempFiles;
+    std::mutex tempFilesMutex;
+    
+    // Номер временного файла на диске - его номер в runs плюс tempIndexBase: после
+    // возобновления новые файлы не совпадают по имени с файлами из манифеста
+    size_t tempIndexBase = 0;
+    const std::string tempPrefix;          // начало имени файлов в каталогах --tmp-dir
+    
+    // Временные файлы, записанные в манифест (защищены runsMutex): при ошибке они
+    // не удаляются. savedRuns - сколько первых файлов runs в нем перечислено,
+    // manifestLines - строки этих файлов в манифесте, а tempNumberLimit - записанная
+    // в него граница номеров: больше номеров всех созданных временных файлов
+    std::vector<std::string> manifestRuns;
+    size_t savedRuns = 0;
+    std::string manifestLines;
+    size_t tempNumberLimit = 0;
+    
+    // Выбрана ли стратегия Keys и бюджет памяти пакета; задаются в sort()
+    bool keysOnly = false;
+    size_t batchBudget = 0;
+    
+    SortStats statistics;
+    
+    // Память, которой распоряжается сортировка: лимит без памяти самого процесса
+    size_t usableMemory() const {
+        return options.memoryLimit > PROCESS_MEMORY ? options.memoryLimit - PROCESS_MEMORY : 0;
+    }
+    
+    // Количество буферов на один открытый файл
+    size_t buffersPerStream() const {
+        return io ? 2 : 1;
+    }
+    
+    // Размер блока ввода-вывода, когда одновременно открыто streams файлов:
+    // на буферы отводится не более четверти лимита памяти
+    size_t ioBlockSize(size_t streams) const {
+        return std::clamp(usableMemory() / (4 * streams * buffersPerStream()), MIN_IO_BLOCK, MAX_IO_BLOCK);
+    }
+    
+    // Память буферов ввода-вывода streams открытых файлов
+    size_t ioMemory(size_t streams) const {
+        return streams * buffersPerStream() * ioBlockSize(streams);
+    }
+    
+    // Бюджет памяти одного пакета. Одновременно в памяти находятся пакеты всех потоков
+    // сортировки, один пакет в очереди и один читаемый; кроме того, учитываются буферы
+    // чтения входного файла и записи временных файлов
+    size_t batchMemoryBudget(size_t threadCount) const {
+        const size_t fixedMemory = ioMemory(threadCount + 1);
+        if (usableMemory() <= fixedMemory) {
+            return 0;
+        }
+        const size_t budget = (usableMemory() - fixedMemory) / (threadCount + 2);
+        return budget >= MIN_BATCH_MEMORY ? budget : 0;
+    }
+    
+    // Память сведений о временных файлах: при промежуточном проходе одновременно
+    // существуют разреженные индексы исходных и слитых файлов
+    size_t runsMemory() const {
+        size_t memory = runs.capacity() * sizeof(RunInfo);
+        for (const auto& info : runs) {
+            memory += info.path.capacity() + 2 * info.index.capacity() * sizeof(RunIndexEntry);
+        }
+        return memory;
+    }
+    
+    // Память буферов слияния: доля MERGE_BUFFER_SHARE лимита за вычетом сведений
+    // о временных файлах. Остальное - запас на кучу, которую пакеты занимали при
+    // формировании: распределитель возвращает ее системе лишь частично
+    size_t mergeMemory() const {
+        const size_t share = usableMemory() / MERGE_BUFFER_SHARE;
+        const size_t reserved = runsMemory();
+        return share > reserved ? share - reserved : 0;
+    }
+    
+    // Память чтения значений при выводе в стратегии Keys: такая же доля лимита
+    size_t gatherMemory() const {
+        return usableMemory() / MERGE_BUFFER_SHARE;
+    }
+    
+    // Объем строки результата для записи временного файла. В стратегии Keys
+    // значение записи - положение значения во входном файле
+    uint64_t textSize(uint64_t key, std::string_view value) const {
+        KeyLocator locator;
+        const uint64_t valueSize = keysOnly && decodeLocator(value, locator) ? locator.length : value.size();
+        return decimalDigits(key) + valueSize + 2;
+    }
+    
+    // Определяет стратегию сортировки. Стратегии Keys нужен обычный входной файл:
+    // значения читаются из него повторно. При --strategy=auto она выбирается, если
+    // средняя длина строки в начале файла не меньше KEY_STRATEGY_MIN_LINE
+    bool chooseKeysOnly() const {
+        std::error_code error;
+        if (options.strategy == SortStrategy::Records || !std::filesystem::is_regular_file(inputPath, error)) {
+            if (options.strategy == SortStrategy::Keys) {
+                std::cerr << "Предупреждение: стратегии keys нужен обычный входной файл, используется records" << std::endl;
+            }
+            return false;
+        }
+        if (options.strategy == SortStrategy::Keys) {
+            return true;
+        }
+        
+        BlockReader sample(inputPath, MIN_IO_BLOCK);
+        uint64_t bytes = 0;
+        uint64_t lines = 0;
+        std::string_view line;
+        while (bytes < STRATEGY_SAMPLE && sample.nextLine(line)) {
+            bytes += line.size() + 1;
+            lines++;
+        }
+        return lines != 0 && bytes / lines >= KEY_STRATEGY_MIN_LINE;
+    }
+    
+    // Ведется ли манифест сортировки
+    bool manifestEnabled() const {
+        return !options.manifestPath.empty();
+    }
+    
+    // Сохраняет сведения о записанном временном файле. С манифестом в него заносится
+    // самый длинный непрерывный ряд готовых файлов от начала, заканчивающийся
+    // на границе входного файла: файлы пакетов завершаются не по порядку
+    bool storeRun(size_t index, RunInfo& info) {
+        statistics.spilledBytes += info.end.offset;
+        if (manifestEnabled() && info.inputEnd != 0) {
+            info.inputSample = sampleInput(info.inputEnd);
+        }
+        std::lock_guard<std::mutex> lock(runsMutex);
+        if (runs.size() <= index) {
+            runs.resize(index + 1);
+        }
+        runs[index] = std::move(info);
+        if (!manifestEnabled()) {
+            return true;
+        }
+        
+        size_t count = savedRuns;
+        size_t ready = savedRuns;
+        while (count < runs.size() && !runs[count].path.empty()) {
+            if (runs[count++].inputEnd != 0) {
+                ready = count;
+            }
+        }
+        if (ready == savedRuns) {
+            return true;
+        }
+        std::vector<const RunInfo*> list;
+        for (size_t i = 0; i < ready; ++i) {
+            list.push_back(&runs[i]);
+        }
+        savedRuns = ready;
+        return writeManifest(list);
+    }
+    
+    // Начало имени временных файлов в каталоге --tmp-dir: имя результата и хеш его
+    // полного пути. Сортировки в одинаково названные файлы разных каталогов не
+    // затирают временные файлы друг друга в общем каталоге, а повторный запуск той же
+    // сортировки получает те же имена и находит файлы из манифеста
+    std::string tempFilePrefix() const {
+        std::error_code error;
+        const std::filesystem::path absolute = std::filesystem::absolute(outputPath, error);
+        const std::string path = (error ? std::filesystem::path(outputPath) : absolute).lexically_normal().string();
+        std::ostringstream prefix;
+        prefix << std::filesystem::path(outputPath).filename().string() << '.' << std::hex << std::setw(16)
+               << std::setfill('0') << hashBytes(0, path.data(), path.size()) << ".temp";
+        return prefix.str();
+    }
+    
+    // Имя временного файла с номером number в каталоге dir (пустой - рядом с результатом)
+    std::string tempFilePath(size_t number, const std::string& dir) const {
+        const std::string name = std::to_string(number);
+        if (dir.empty()) {
+            return outputPath + ".temp" + name;
+        }
+        return (std::filesystem::path(dir) / (tempPrefix + name)).string();
+    }
+    
+    // Возвращает имя временного файла с номером index и запоминает его для удаления
+    // при ошибке. Файлы распределяются по каталогам --tmp-dir по кругу, поэтому
+    // запись пакетов и чтение при слиянии нагружают все устройства
+    std::string createTempFile(size_t index) {
+        const size_t number = index + tempIndexBase;
+        const std::string path = options.tempDirs.empty()
+            ? tempFilePath(number, std::string())
+            : tempFilePath(number, options.tempDirs[number % options.tempDirs.size()]);
+        std::lock_guard<std::mutex> lock(tempFilesMutex);
+        if (manifestEnabled()) {
+            std::lock_guard<std::mutex> runsLock(runsMutex);
+            if (number >= tempNumberLimit) {
+                tempNumberLimit = number + TEMP_NUMBER_RESERVE;
+                if (!writeManifestFile()) {
+                    return std::string();
+                }
+            }
+        }
+        tempFiles.push_back(path);
+        return path;
+    }
+    
+    // Удаляет временные файлы, оставшиеся после прерванной сортировки.
+    // Файлы из манифеста остаются: с ними сортировку можно возобновить
+    void removeTempFiles() {
+        std::lock_guard<std::mutex> lock(tempFilesMutex);
+        std::lock_guard<std::mutex> runsLock(runsMutex);
+        for (const auto& path : tempFiles) {
+            if (std::find(manifestRuns.begin(), manifestRuns.end(), path) == manifestRuns.end()) {
+                std::error_code error;
+                std::filesystem::remove(path, error);
+            }
+        }
+        tempFiles.clear();
+    }
+    
+    // Удаляет временные файлы после записи результата. С --keep-runs они остаются
+    // вместе с манифестом: следующая сортировка дополненного входного файла
+    // сольет их с временными файлами одних только новых строк
+    void releaseRuns() {
+        if (!options.keepRuns) {
+            removeFiles(runs);
+        }
+    }
+    
+    // Контрольная сумма до MANIFEST_SAMPLE байт входного файла перед позицией end
+    uint64_t sampleInput(uint64_t end) const {
+        const uint64_t begin = end > MANIFEST_SAMPLE ? end - MANIFEST_SAMPLE : 0;
+        std::vector<char> data(static_cast<size_t>(end - begin));
+        std::ifstream file(inputPath, std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(begin));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        return hashBytes(end, data.data(), static_cast<size_t>(file.gcount()));
+    }
+    
+    // Описание формата временных файлов: файлы другого формата из манифеста непригодны
+    std::string manifestFormat() const {
+        return std::string("format ") + (options.spillFormat == SpillFormat::Compact ? "compact" : "plain") +
+               (keysOnly ? " keys" : " records");
+    }
+    
+    // Записывает манифест: формат, границу номеров временных файлов и готовые
+    // временные файлы в порядке слияния с их размерами, контрольными суммами
+    // и границами во входном файле
+    bool writeManifest(const std::vector<const RunInfo*>& list) {
+        std::ostringstream lines;
+        std::vector<std::string> paths;
+        for (const RunInfo* info : list) {
+            std::error_code error;
+            const std::filesystem::path absolute = std::filesystem::absolute(info->path, error);
+            lines << "run " << info->records << ' ' << info->end.offset << ' ' << info->checksum << ' '
+                  << info->inputEnd << ' ' << info->inputSample << ' '
+                  << (error ? info->path : absolute.string()) << "\n";
+            paths.push_back(info->path);
+        }
+        manifestLines = lines.str();
+        if (!writeManifestFile()) {
+            return false;
+        }
+        manifestRuns.swap(paths);
+        return true;
+    }
+    
+    // Записывает манифест из manifestLines и tempNumberLimit. Новый манифест
+    // заменяет прежний переименованием, поэтому прерванная запись его не портит
+    bool writeManifestFile() const {
+        const std::string temporary = options.manifestPath + ".new";
+        std::ofstream file(temporary, std::ios::trunc);
+        file << MANIFEST_HEADER << "\n" << manifestFormat() << "\n" << "next " << tempNumberLimit << "\n" << manifestLines;
+        file.close();
+        
+        std::error_code error;
+        if (file) {
+            std::filesystem::rename(temporary, options.manifestPath, error);
+        }
+        if (!file || error) {
+            std::cerr << "Ошибка: не удалось записать манифест " + options.manifestPath + "\n";
+            return false;
+        }
+        return true;
+    }
+    
+    // Перечитывает временный файл из манифеста: сверяет размер, число записей,
+    // контрольную сумму и границу во входном файле и заново строит разреженный индекс
+    bool verifyRun(RunInfo& info) const {
+        std::error_code error;
+        if (std::filesystem::file_size(info.path, error) != info.end.offset || error) {
+            return false;
+        }
+        RunInfo scanned;
+        scanned.path = info.path;
+        RunReader reader({&info.path, 0, info.end.offset, 0}, options.spillFormat, ioBlockSize(1), nullptr);
+        if (!reader) {
+            return false;
+        }
+        KeyValuePair pair;
+        ReadStatus status;
+        while ((status = reader.next(pair)) == ReadStatus::Ok) {
+            scanned.checksum = hashRecord(scanned.checksum, pair.key, pair.value);
+            scanned.add(pair.key, reader.lastSize(), textSize(pair.key, pair.value));
+        }
+        if (status != ReadStatus::End || reader.failed() || scanned.records != info.records ||
+            scanned.checksum != info.checksum || scanned.end.offset != info.end.offset) {
+            return false;
+        }
+        if (info.inputEnd != 0 && sampleInput(info.inputEnd) != info.inputSample) {
+            return false;
+        }
+        scanned.inputEnd = info.inputEnd;
+        scanned.inputSample = info.inputSample;
+        info = std::move(scanned);
+        return true;
+    }
+    
+    // Удаляет временные файлы прерванной сортировки с номерами меньше next, которых
+    // нет среди оставшихся в runs: пакеты, завершенные не по порядку, недописанные
+    // файлы и исходные файлы слияния, прерванного до их удаления. Номер каждого
+    // созданного файла меньше записанного в манифест, а удаляются только имена
+    // этой сортировки - в каждом каталоге --tmp-dir или рядом с результатом
+    void removeStaleRuns(size_t next) const {
+        auto normalize = [](const std::string& path) {
+            std::error_code error;
+            const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+            return (error ? std::filesystem::path(path) : absolute).lexically_normal().string();
+        };
+        std::vector<std::string> kept;
+        for (const auto& info : runs) {
+            kept.push_back(normalize(info.path));
+        }
+        std::sort(kept.begin(), kept.end());
+        
+        const std::vector<std::string> dirs = options.tempDirs.empty() ? std::vector<std::string>(1) : options.tempDirs;
+        for (size_t number = 0; number < next; ++number) {
+            for (const auto& dir : dirs) {
+                const std::string path = tempFilePath(number, dir);
+                if (!std::binary_search(kept.begin(), kept.end(), normalize(path))) {
+                    std::error_code error;
+                    std::filesystem::remove(path, error);
+                }
+            }
+        }
+    }
+    
+    // Загружает манифест прерванной или сохраненной (--keep-runs) сортировки:
+    // проверенные временные файлы становятся первыми в runs, а в offset
+    // возвращается позиция входного файла, с которой продолжается формирование
+    // файлов. Непригодный файл отбрасывается вместе со всеми последующими; ряд
+    // оставшихся укорачивается до последней границы во входном файле
+    bool loadManifest(uint64_t& offset) {
+        offset = 0;
+        std::ifstream file(options.manifestPath);
+        if (!file) {
+            return true; // Манифеста нет: сортировка начинается с начала
+        }
+        
+        std::vector<RunInfo> listed;
+        std::string line;
+        std::string format;
+        size_t next = 0;
+        bool valid = std::getline(file, line) && line == MANIFEST_HEADER && std::getline(file, format);
+        if (valid && std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string word;
+            valid = fields >> word >> next && word == "next";
+        }
+        while (valid && std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string word;
+            RunInfo info;
+            valid = fields >> word >> info.records >> info.end.offset >> info.checksum >> info.inputEnd >> info.inputSample &&
+                    word == "run" && std::getline(fields >> std::ws, info.path) && !info.path.empty();
+            listed.push_back(std::move(info));
+        }
+        if (!valid || next < listed.size()) {
+            std::cerr << "Предупреждение: манифест " << options.manifestPath
+                      << " поврежден, сортировка начинается с начала" << std::endl;
+            return true;
+        }
+        if (format != manifestFormat()) {
+            std::cerr << "Предупреждение: временные файлы манифеста " << options.manifestPath
+                      << " записаны в другом формате, сортировка начинается с начала" << std::endl;
+            removeFiles(listed);
+            listed.clear();
+        }
+        
+        std::vector<std::string> paths;
+        for (const auto& info : listed) {
+            paths.push_back(info.path);
+        }
+        for (auto& info : listed) {
+            if (!verifyRun(info)) {
+                std::cerr << "Предупреждение: временный файл " << info.path << " из манифеста поврежден или "
+                          << "не соответствует входному файлу; он и следующие файлы формируются заново" << std::endl;
+                break;
+            }
+            runs.push_back(std::move(info));
+        }
+        while (!runs.empty() && runs.back().inputEnd == 0) {
+            runs.pop_back();
+        }
+        for (size_t i = runs.size(); i < paths.size(); ++i) {
+            std::remove(paths[i].c_str());
+        }
+        removeStaleRuns(next);
+        
+        offset = runs.empty() ? 0 : runs.back().inputEnd;
+        tempIndexBase = next - runs.size();
+        tempNumberLimit = next;
+        savedRuns = runs.size();
+        if (!runs.empty()) {
+            std::cout << "Манифест: повторно используются временных файлов: " << runs.size()
+                      << ", входной файл читается с байта " << offset << std::endl;
+        }
+        std::vector<const RunInfo*> list;
+        for (const auto& info : runs) {
+            list.push_back(&info);
+        }
+        return writeManifest(list);
+    }
+    
+    // Проверяет, что каталоги временных файлов существуют
+    bool checkTempDirs() const {
+        for (const auto& dir : options.tempDirs) {
+            std::error_code error;
+            if (!std::filesystem::is_directory(dir, error)) {
+                std::cerr << "Ошибка: каталог временных файлов " << dir << " не найден" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Читает очередную порцию строк из входного файла, пока она укладывается в бюджет памяти.
+    // Строка, превысившая бюджет, откладывается до следующего пакета; пакет из одной
+    // строки формируется всегда, даже если она сама больше бюджета
+    bool readBatch(InputCursor& input, RawBatch& batch, size_t memoryBudget) {
+        batch.lineCount = 0;
+        batch.text.clear();
+        batch.text.reserve(INITIAL_BATCH_TEXT);
+        size_t usedMemory = 0; // память строк без учета текста пакета
+        
+        std::string_view line;
+        while (input.hasPendingLine || input.file.nextLine(line)) {
+            if (input.hasPendingLine) {
+                line = input.pendingLine;
+                input.hasPendingLine = false;
+            } else {
+                statistics.inputBytes.fetch_add(line.size() + 1, std::memory_order_relaxed);
+            }
+            
+            // При нехватке емкости текст растет вдвое; во время перевыделения
+            // в памяти одновременно находятся старый и новый буферы
+            const size_t required = batch.text.size() + line.size() + 1;
+            size_t capacity = batch.text.capacity();
+            size_t textMemory = capacity;
+            if (required > capacity) {
+                capacity = std::max(required, 2 * capacity);
+                textMemory += capacity;
+            }
+            
+            const size_t memory = lineMemory(line);
+            if (batch.lineCount != 0 &&
+                (usedMemory + memory + textMemory > memoryBudget || required > MAX_BATCH_TEXT)) {
+                // Строка указывает в буфер читателя, поэтому ее нужно скопировать
+                input.pendingLine.assign(line.data(), line.size());
+                input.hasPendingLine = true;
+                break;
+            }
+            
+            batch.text.reserve(capacity);
+            batch.text.append(line).push_back('\n');
+            batch.lineCount++;
+            usedMemory += memory;
+            input.offset += line.size() + 1;
+        }
+        
+        return batch.lineCount != 0;
+    }
+    
+    // Устойчиво упорядочивает записи пакета по ключу, выбирая способ по данным.
+    // Уже упорядоченный пакет не сортируется, строго убывающий разворачивается,
+    // а несколько возрастающих участков сливаются попарно. При небольшом числе
+    // различных ключей используется сортировка подсчетом, иначе - выбранный алгоритм
+    template <typename Record>
+    void sortByKey(std::vector<Record>& batch) {
+        auto less = [](const Record& a, const Record& b) { return a.key < b.key; };
+        
+        // Границы возрастающих участков; для строго убывающего пакета каждый участок -
+        // одна запись, поэтому он проверяется отдельно
+        std::vector<size_t> stretches{0};
+        bool descending = batch.size() > 1;
+        for (size_t i = 1; i < batch.size(); ++i) {
+            if (batch[i].key < batch[i - 1].key) {
+                if (stretches.size() <= MAX_PRESORTED_STRETCHES) {
+                    stretches.push_back(i);
+                }
+            } else {
+                descending = false;
+            }
+            if (!descending && stretches.size() > MAX_PRESORTED_STRETCHES) {
+                break;
+            }
+        }
+        
+        if (descending) {
+            // Равных ключей нет, поэтому разворот сохраняет устойчивость
+            std::reverse(batch.begin(), batch.end());
+            statistics.presortedBatches++;
+            return;
+        }
+        if (stretches.size() <= MAX_PRESORTED_STRETCHES) {
+            // Сливаем соседние участки, пока не останется один; std::inplace_merge устойчива
+            stretches.push_back(batch.size());
+            while (stretches.size() > 2) {
+                std::vector<size_t> merged{0};
+                for (size_t i = 2; i < stretches.size(); i += 2) {
+                    std::inplace_merge(batch.begin() + stretches[i - 2], batch.begin() + stretches[i - 1],
+                                       batch.begin() + stretches[i], less);
+                    merged.push_back(stretches[i]);
+                }
+                if (stretches.size() % 2 == 0) {
+                    merged.push_back(stretches.back());
+                }
+                stretches.swap(merged);
+            }
+            statistics.presortedBatches++;
+            return;
+        }
+        
+        if (batch.size() >= MIN_RADIX_SORT_SIZE && countingSortByKey(batch, MAX_COUNTED_KEYS)) {
+            statistics.countedBatches++;
+            return;
+        }
+        if (options.engine == SortEngine::Radix && batch.size() >= MIN_RADIX_SORT_SIZE) {
+            radixSortByKey(batch);
+        } else {
+            std::stable_sort(batch.begin(), batch.end(), less);
+        }
+    }
+    
+    // Стратегия Keys: разбирает строки сразу при чтении и сохраняет только ключи
+    // и положения значений. Записи и вспомогательный буфер сортировки должны
+    // уместиться в бюджет памяти, поэтому емкость пакета выделяется заранее
+    bool readLocators(InputCursor& input, RawBatch& batch, size_t memoryBudget) {
+        // Разбор идет при чтении, поэтому его время включает и чтение файла
+        const Clock::time_point parseStart = Clock::now();
+        const uint64_t startOffset = input.offset;
+        const size_t capacity = std::max<size_t>(1, memoryBudget / (2 * sizeof(KeyLocator)));
+        batch.lineCount = 0;
+        batch.locators.clear();
+        batch.locators.reserve(capacity);
+        
+        std::string_view line;
+        while (batch.locators.size() < capacity && input.file.nextLine(line)) {
+            const uint64_t lineOffset = input.offset;
+            input.offset += line.size() + 1;
+            batch.lineCount++;
+            
+            KeyLocator locator;
+            std::string_view value;
+            if (splitKeyValue(line, locator.key, value)) {
+                locator.offset = lineOffset + (value.data() - line.data());
+                locator.length = static_cast<uint32_t>(value.size());
+                batch.locators.push_back(locator);
+            } else {
+                std::cerr << "Предупреждение: невозможно разобрать строку: " + std::string(line) + "\n";
+                statistics.rejectedLines++;
+            }
+        }
+        
+        statistics.inputBytes += input.offset - startOffset;
+        statistics.parseNanos += elapsedNanos(parseStart);
+        return batch.lineCount != 0;
+    }
+    
+    // Стратегия Keys: сортирует ключи пакета и записывает во временный файл
+    // вместо значений их положения
+    bool sortLocators(RawBatch& raw, size_t blockSize) {
+        std::vector<KeyLocator>& batch = raw.locators;
+        statistics.records += batch.size();
+        updateMax(statistics.peakBatchMemory, 2 * batch.capacity() * sizeof(KeyLocator));
+        
+        const Clock::time_point sortStart = Clock::now();
+        sortByKey(batch);
+        statistics.sortNanos += elapsedNanos(sortStart);
+        
+        const Clock::time_point spillStart = Clock::now();
+        
+        // Весь входной файл поместился в один пакет: значения сразу читаются в результат
+        if (raw.complete) {
+            BlockWriter output(outputPath, blockSize, io.get());
+            if (!output) {
+                std::cerr << "Ошибка: не удалось создать файл результата " + outputPath + "\n";
+                return false;
+            }
+            ValueGatherer gather(inputPath, output, batchBudget, MAX_IO_BLOCK);
+            if (!gather) {
+                std::cerr << "Ошибка: не удалось открыть входной файл " + inputPath + "\n";
+                return false;
+            }
+            for (const auto& locator : batch) {
+                gather.add(locator);
+            }
+            if (!gather.finish()) {
+                std::cerr << "Ошибка: не удалось прочитать значения из входного файла " + inputPath + "\n";
+                return false;
+            }
+            if (!output.close()) {
+                std::cerr << "Ошибка: не удалось записать файл результата " + outputPath + "\n";
+                return false;
+            }
+            statistics.spillNanos += elapsedNanos(spillStart);
+            return true;
+        }
+        
+        const std::string tempFile = createTempFile(raw.index);
+        RunWriter output(tempFile, options.spillFormat, blockSize, io.get(), manifestEnabled());
+        if (!output) {
+            std::cerr << "Ошибка: не удалось создать временный файл " + tempFile + "\n";
+            return false;
+        }
+        char bytes[LOCATOR_SIZE];
+        for (const auto& locator : batch) {
+            output.write(locator.key, encodeLocator(locator, bytes), decimalDigits(locator.key) + locator.length + 2);
+        }
+        if (!output.close()) {
+            std::cerr << "Ошибка: не удалось записать временный файл " + tempFile + "\n";
+            return false;
+        }
+        statistics.spillNanos += elapsedNanos(spillStart);
+        output.result().inputEnd = raw.inputEnd;
+        return storeRun(raw.index, output.result());
+    }
+    
+    // Сортирует часть файла и записывает во временный файл
+    bool sortBatch(RawBatch& raw, size_t blockSize) {
+        if (keysOnly) {
+            return sortLocators(raw, blockSize);
+        }
+        
+        std::vector<BatchRecord> batch;
+        batch.reserve(raw.lineCount);
+        
+        // Разбор строк пакета
+        const Clock::time_point parseStart = Clock::now();
+        // Текст просматривается один раз: до первого ':' или '\n' строки, затем до ее конца
+        const char* position = raw.text.data();
+        const char* end = position + raw.text.size();
+        while (position < end) {
+            const char* separator = findSeparator(position, end);
+            const char* lineEnd = *separator == '\n'
+                ? separator
+                : static_cast<const char*>(std::memchr(separator + 1, '\n', end - separator - 1));
+            const std::string_view line(position, lineEnd - position);
+            const char* lineStart = position;
+            position = lineEnd + 1;
+            
+            BatchRecord record;
+            if (*separator == ':' && parseKey(lineStart, separator, record.key)) {
+                record.offset = static_cast<uint32_t>(separator + 1 - raw.text.data());
+                record.length = static_cast<uint32_t>(lineEnd - separator - 1);
+                batch.push_back(record);
+            } else {
+                // Сообщение собирается целиком, чтобы вывод разных потоков не перемешивался
+                std::cerr << "Предупреждение: невозможно разобрать строку: " + std::string(line) + "\n";
+                statistics.rejectedLines++;
+            }
+        }
+        statistics.parseNanos += elapsedNanos(parseStart);
+        statistics.records += batch.size();
+        updateMax(statistics.peakBatchMemory, raw.text.capacity() + 2 * batch.capacity() * sizeof(BatchRecord));
+        
+        // Устойчивая сортировка по ключу
+        const Clock::time_point sortStart = Clock::now();
+        sortByKey(batch);
+        statistics.sortNanos += elapsedNanos(sortStart);
+        
+        const Clock::time_point spillStart = Clock::now();
+        
+        // Весь входной файл поместился в один пакет: результат пишется сразу,
+        // без временного файла и последующего слияния
+        if (raw.complete) {
+            BlockWriter output(outputPath, blockSize, io.get());
+            if (!output) {
+                std::cerr << "Ошибка: не удалось создать файл результата " + outputPath + "\n";
+                return false;
+            }
+            for (const auto& record : batch) {
+                output.writeLine(record.key, std::string_view(raw.text.data() + record.offset, record.length));
+            }
+            if (!output.close()) {
+                std::cerr << "Ошибка: не удалось записать файл результата " + outputPath + "\n";
+                return false;
+            }
+            statistics.spillNanos += elapsedNanos(spillStart);
+            return true;
+        }
+        
+        // Запись отсортированного пакета во временный файл.
+        // Файл создается даже для пакета без корректных строк, чтобы номера были непрерывны
+        const std::string tempFile = createTempFile(raw.index);
+        RunWriter output(tempFile, options.spillFormat, blockSize, io.get(), manifestEnabled());
+        if (!output) {
+            std::cerr << "Ошибка: не удалось создать временный файл " + tempFile + "\n";
+            return false;
+        }
+        
+        for (const auto& record : batch) {
+            output.write(record.key, std::string_view(raw.text.data() + record.offset, record.length),
+                         decimalDigits(record.key) + record.length + 2);
+        }
+        
+        if (!output.close()) {
+            std::cerr << "Ошибка: не удалось записать временный файл " + tempFile + "\n";
+            return false;
+        }
+        statistics.spillNanos += elapsedNanos(spillStart);
+        output.result().inputEnd = raw.inputEnd;
+        return storeRun(raw.index, output.result());
+    }
+    
+    // Выбор с заменой: читает следующую корректную строку входного файла в record.
+    // Номер временного файла назначается при помещении записи в кучу
+    bool readSelectionRecord(InputCursor& input, SelectionRecord& record, uint64_t& sequence) {
+        std::string_view line;
+        while (input.hasPendingLine || input.file.nextLine(line)) {
+            const uint64_t lineOffset = input.offset;
+            if (input.hasPendingLine) {
+                line = input.pendingLine;
+                input.hasPendingLine = false;
+            } else {
+                statistics.inputBytes.fetch_add(line.size() + 1, std::memory_order_relaxed);
+            }
+            input.offset += line.size() + 1;
+            
+            std::string_view value;
+            if (!splitKeyValue(line, record.key, value)) {
+                std::cerr << "Предупреждение: невозможно разобрать строку: " + std::string(line) + "\n";
+                statistics.rejectedLines++;
+                continue;
+            }
+            char bytes[LOCATOR_SIZE];
+            if (keysOnly) {
+                const KeyLocator locator{record.key, lineOffset + (value.data() - line.data()),
+                                         static_cast<uint32_t>(value.size())};
+                value = encodeLocator(locator, bytes);
+            }
+            record.value.assign(value.data(), value.size());
+            record.sequence = sequence++;
+            statistics.records++;
+            return true;
+        }
+        return false;
+    }
+    
+    // Формирование временных файлов выбором с заменой. Куча заполняется строками
+    // в пределах бюджета памяти; наименьшая запись текущего файла записывается в него,
+    // а освободившееся место занимают следующие строки. Строка с ключом меньше
+    // последнего записанного откладывается до следующего файла. На случайных данных
+    // файлы получаются примерно вдвое больше бюджета, почти упорядоченный вход дает
+    // один файл. Строка никогда не попадает в файл с меньшим номером, чем предшествующая
+    // ей строка с тем же ключом, поэтому слияние файлов по порядку номеров устойчиво
+    bool selectRuns(InputCursor& input, size_t& tempFileCount, size_t memoryBudget, size_t blockSize) {
+        auto later = [](const SelectionRecord& a, const SelectionRecord& b) {
+            if (a.run != b.run) {
+                return a.run > b.run;
+            }
+            return a.key != b.key ? a.key > b.key : a.sequence > b.sequence;
+        };
+        // Память значения вне записи: короткие строки хранятся в самом объекте std::string,
+        // а длинные занимают отдельный блок кучи вместе с его служебными данными.
+        // Блоки освобождаются и выделяются вразнобой, поэтому учитывается и запас
+        // на фрагментацию
+        const size_t inlineCapacity = std::string().capacity();
+        auto valueMemory = [inlineCapacity](const std::string& value) {
+            return value.capacity() > inlineCapacity ? (value.capacity() + 1 + ALLOCATION_OVERHEAD) * 5 / 4 : 0;
+        };
+        
+        std::vector<SelectionRecord> heap;
+        size_t valuesMemory = 0;
+        SelectionRecord incoming;
+        bool hasIncoming = false;
+        uint64_t sequence = 0;
+        
+        std::unique_ptr<RunWriter> output;
+        size_t currentRun = tempFileCount;
+        uint64_t lastKey = 0;
+        
+        // Закрывает текущий временный файл и сохраняет сведения о нем
+        auto closeRun = [&]() {
+            if (!output->close()) {
+                std::cerr << "Ошибка: не удалось записать временный файл " + output->result().path + "\n";
+                return false;
+            }
+            const bool stored = storeRun(currentRun, output->result());
+            output.reset();
+            return stored;
+        };
+        
+        while (true) {
+            // Куча пополняется, пока очередная строка укладывается в бюджет; в пустую
+            // кучу строка помещается всегда. При росте массива кучи в памяти
+            // одновременно находятся старый и новый буферы
+            while (hasIncoming || readSelectionRecord(input, incoming, sequence)) {
+                hasIncoming = true;
+                size_t capacity = heap.capacity();
+                size_t heapMemory = capacity;
+                if (heap.size() == capacity) {
+                    heapMemory += std::max<size_t>(1, 2 * capacity);
+                }
+                const size_t memory = heapMemory * sizeof(SelectionRecord) + valuesMemory + valueMemory(incoming.value);
+                if (!heap.empty() && memory > memoryBudget) {
+                    break;
+                }
+                updateMax(statistics.peakBatchMemory, memory);
+                
+                incoming.run = output && incoming.key < lastKey ? currentRun + 1 : currentRun;
+                valuesMemory += valueMemory(incoming.value);
+                heap.push_back(std::move(incoming));
+                std::push_heap(heap.begin(), heap.end(), later);
+                incoming = SelectionRecord();
+                hasIncoming = false;
+            }
+            if (heap.empty()) {
+                break;
+            }
+            
+            std::pop_heap(heap.begin(), heap.end(), later);
+            SelectionRecord& top = heap.back();
+            if (output && top.run != currentRun && !closeRun()) {
+                return false;
+            }
+            if (!output) {
+                currentRun = top.run;
+                const std::string tempFile = createTempFile(currentRun);
+                output = std::make_unique<RunWriter>(tempFile, options.spillFormat, blockSize, io.get(), manifestEnabled());
+                if (!*output) {
+                    std::cerr << "Ошибка: не удалось создать временный файл " + tempFile + "\n";
+                    return false;
+                }
+            }
+            output->write(top.key, top.value, textSize(top.key, top.value));
+            lastKey = top.key;
+            valuesMemory -= valueMemory(top.value);
+            heap.pop_back();
+        }
+        
+        if (output) {
+            // Только последний файл заканчивается на границе входного файла:
+            // строки предыдущих перемешаны со строками следующих
+            output->result().inputEnd = input.offset;
+            if (!closeRun()) {
+                return false;
+            }
+            tempFileCount = currentRun + 1;
+        }
+        return true;
+    }
+    
+    // Возвращает число потоков сортировки с учетом настроек
+    size_t workerCount() const {
+        if (options.threads != 0) {
+            return options.threads;
+        }
+        const unsigned hardware = std::thread::hardware_concurrency();
+        return hardware != 0 ? hardware : 1;
+    }
+    
+    // Сливает диапазоны временных файлов inputs в порядке их номеров; каждая запись
+    // результата передается в emit(key, value)
+    template <typename Emit>
+    bool mergeRuns(const std::vector<RunRange>& inputs, size_t blockSize, Emit emit) {
+        // Структура для многопутевого слияния.
+        // Единственный временный файл проходит тот же путь: его нужно преобразовать в текст
+        struct FileEntry {
+            RunReader file;
+            KeyValuePair currentPair{};
+            bool hasNext;
+            bool corrupted;
+            
+            FileEntry(const RunRange& range, SpillFormat format, size_t blockSize, IoExecutor* io)
+                : file(range, format, blockSize, io), hasNext(false), corrupted(false) {
+                readNext();
+            }
+            
+            void readNext() {
+                const ReadStatus status = file.next(currentPair);
+                hasNext = status == ReadStatus::Ok;
+                corrupted = status == ReadStatus::Corrupted || file.failed();
+            }
+        };
+        
+        // Открываем временные файлы
+        std::deque<FileEntry> files;
+        for (const auto& range : inputs) {
+            statistics.mergeReadBytes += range.end - range.begin;
+            files.emplace_back(range, options.spillFormat, blockSize, io.get());
+            if (!files.back().file) {
+                std::cerr << "Ошибка: не удалось открыть временный файл " + *range.path + "\n";
+                return false;
+            }
+        }
+        
+        // Выполняем многопутевое слияние с помощью дерева проигравших.
+        // При равных ключах побеждает меньший номер файла: пакеты формируются в порядке
+        // чтения, а внутри файла порядок уже устойчив, поэтому это сохраняет устойчивость
+        auto less = [&files](size_t a, size_t b) {
+            const FileEntry& lhs = files[a];
+            const FileEntry& rhs = files[b];
+            if (!lhs.hasNext || !rhs.hasNext) {
+                return lhs.hasNext && !rhs.hasNext;
+            }
+            if (lhs.currentPair.key != rhs.currentPair.key) {
+                return lhs.currentPair.key < rhs.currentPair.key;
+            }
+            return a < b;
+        };
+        LoserTree<decltype(less)> tree(files.size(), less);
+        
+        while (files[tree.top()].hasNext) {
+            FileEntry& minEntry = files[tree.top()];
+            
+            // Передаем минимальную пару в результат
+            emit(minEntry.currentPair.key, minEntry.currentPair.value);
+            
+            // Читаем следующую запись из этого файла и переигрываем турнир
+            minEntry.readNext();
+            tree.replay();
+        }
+        
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (files[i].corrupted) {
+                std::cerr << "Ошибка: поврежден временный файл " + *inputs[i].path + "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Сливает диапазоны временных файлов в файл результата. В стратегии Keys значения
+    // читаются из входного файла через ValueGatherer с бюджетом памяти gatherMemory
+    bool mergeToOutput(const std::vector<RunRange>& inputs, size_t blockSize, BlockWriter& output, size_t gatherMemory) {
+        if (!keysOnly) {
+            return mergeRuns(inputs, blockSize, [&output](uint64_t key, std::string_view value) {
+                output.writeLine(key, value);
+            });
+        }
+        
+        ValueGatherer gather(inputPath, output, gatherMemory, MAX_IO_BLOCK);
+        if (!gather) {
+            std::cerr << "Ошибка: не удалось открыть входной файл " + inputPath + "\n";
+            return false;
+        }
+        bool corrupted = false;
+        const bool merged = mergeRuns(inputs, blockSize, [&gather, &corrupted](uint64_t key, std::string_view value) {
+            KeyLocator locator{key, 0, 0};
+            if (decodeLocator(value, locator)) {
+                gather.add(locator);
+            } else {
+                corrupted = true;
+            }
+        });
+        if (!merged) {
+            return false;
+        }
+        if (corrupted) {
+            std::cerr << "Ошибка: поврежден временный файл\n";
+            return false;
+        }
+        if (!gather.finish()) {
+            std::cerr << "Ошибка: не удалось прочитать значения из входного файла " + inputPath + "\n";
+            return false;
+        }
+        return true;
     }
-
-    // Извлечение значения
-    if (colonPos + 1 < line.size()) {
-        pair.value = line.substr(colonPos + 1);
-    } else {
-        pair.value = ""; // Пустое значение
+    
+    // Диапазоны, охватывающие временные файлы целиком
+    static std::vector<RunRange> wholeRuns(const std::vector<RunInfo>& infos) {
+        std::vector<RunRange> ranges;
+        for (const auto& info : infos) {
+            ranges.push_back({&info.path, 0, info.end.offset, 0});
+        }
+        return ranges;
     }
-
-    return true;
-}
-
-// Класс для пакетной обработки файла
-class FileSorter {
-private:
-    const std::string inputPath;
-    const std::string outputPath;
     
-    // Максимальное количество строк для обработки за раз
-    static constexpr size_t BATCH_SIZE = 1000000;
+    // Удаляет временные файлы
+    static void removeFiles(const std::vector<RunInfo>& infos) {
+        for (const auto& info : infos) {
+            std::remove(info.path.c_str());
+        }
+    }
     
-    // Создает временный файл и возвращает его имя
-    std::string createTempFile(size_t index) const {
-        return outputPath + ".temp" + std::to_string(index);
+    // Размер блока чтения, когда одновременно идут groups слияний streams файлов
+    // с записью результата каждое: память слияния делится между их буферами
+    size_t mergeBlockSize(size_t streams, size_t groups = 1) const {
+        const size_t overhead = groups * streams * MERGE_STREAM_MEMORY;
+        const size_t memory = mergeMemory() > overhead ? mergeMemory() - overhead : 0;
+        return std::clamp(memory / (groups * (streams + 1) * buffersPerStream()), MIN_IO_BLOCK, MAX_IO_BLOCK);
     }
     
-    // Сортирует часть файла и записывает во временный файл
-    bool sortBatch(std::ifstream& input, size_t batchIndex, size_t& linesProcessed) {
-        std::vector<KeyValuePair> batch;
-        batch.reserve(BATCH_SIZE);
+    // Составляет план слияния. Наибольшая ширина слияния ограничена опцией --fan-in
+    // и тем, чтобы каждому файлу достался буфер не меньше PREFERRED_MERGE_BLOCK;
+    // число проходов - наименьшее, при котором такой ширины хватает. Затем ширина
+    // уменьшается до минимальной, достаточной для этого числа проходов: группы
+    // получаются равными, а буферы - крупнее
+    MergePlan planMerge(size_t runCount) const {
+        const size_t memoryFanIn = mergeMemory() / (PREFERRED_MERGE_BLOCK * buffersPerStream());
+        const size_t limitFanIn = options.fanIn != 0 ? options.fanIn : DEFAULT_MAX_FAN_IN;
+        const size_t maxFanIn = std::max<size_t>(2, std::min(limitFanIn, memoryFanIn > 1 ? memoryFanIn - 1 : 1));
         
-        // Чтение строк из входного файла
-        std::string line;
-        size_t lineIndex = 0;
-        while (batch.size() < BATCH_SIZE && std::getline(input, line)) {
-            KeyValuePair pair;
-            pair.originalIndex = linesProcessed + lineIndex;
-            
-            if (parseKeyValue(line, pair)) {
-                batch.push_back(std::move(pair));
-            } else {
-                std::cerr << "Предупреждение: невозможно разобрать строку: " << line << std::endl;
+        // Проверяет, покрывают ли passes проходов шириной fanIn все runCount файлов
+        auto covers = [runCount](size_t fanIn, size_t passes) {
+            size_t capacity = 1;
+            for (size_t i = 0; i < passes && capacity < runCount; ++i) {
+                capacity *= fanIn;
+            }
+            return capacity >= runCount;
+        };
+        
+        MergePlan plan;
+        plan.runs = runCount;
+        plan.passes = 1;
+        while (!covers(maxFanIn, plan.passes)) {
+            plan.passes++;
+        }
+        plan.fanIn = std::min(runCount, size_t(2));
+        while (!covers(plan.fanIn, plan.passes)) {
+            plan.fanIn++;
+        }
+        plan.blockSize = mergeBlockSize(plan.fanIn);
+        return plan;
+    }
+    
+    // Число диапазонов, на которые разбивается последний проход слияния fanIn файлов:
+    // ограничено числом потоков, лимитом памяти и объемом данных
+    size_t partitionCount(const std::vector<RunInfo>& infos) const {
+        uint64_t records = 0;
+        for (const auto& info : infos) {
+            records += info.records;
+        }
+        const size_t partMemory = (infos.size() + 1) * buffersPerStream() * MIN_PARTITION_BLOCK +
+                                  infos.size() * MERGE_STREAM_MEMORY;
+        const size_t memoryParts = mergeMemory() / partMemory;
+        const uint64_t dataParts = records / MIN_PARTITION_RECORDS;
+        return std::max<size_t>(1, std::min<uint64_t>({workerCount(), memoryParts, dataParts}));
+    }
+    
+    // Выбирает не более parts - 1 разделителей: квантили ключей разреженных индексов.
+    // Записи с ключом меньше k-го разделителя попадают в диапазоны до k-го включительно
+    static std::vector<uint64_t> chooseSplitters(const std::vector<RunInfo>& infos, size_t parts) {
+        std::vector<uint64_t> sample;
+        for (const auto& info : infos) {
+            for (const auto& entry : info.index) {
+                sample.push_back(entry.key);
             }
-            lineIndex++;
         }
+        std::sort(sample.begin(), sample.end());
         
-        if (batch.empty()) {
-            return false; // Нет данных для обработки
+        std::vector<uint64_t> splitters;
+        for (size_t i = 1; i < parts; ++i) {
+            const uint64_t key = sample[i * sample.size() / parts];
+            // Разделитель, равный наименьшему ключу или предыдущему разделителю, дал бы пустой диапазон
+            if (key != sample.front() && (splitters.empty() || splitters.back() != key)) {
+                splitters.push_back(key);
+            }
+        }
+        return splitters;
+    }
+    
+    // Находит позицию первой записи временного файла с ключом не меньше splitter: по
+    // индексу выбирается опорная точка, дальше записи (не больше RUN_INDEX_INTERVAL)
+    // просматриваются последовательно
+    bool findBoundary(const RunInfo& info, uint64_t splitter, RunPosition& position) const {
+        auto entry = std::lower_bound(info.index.begin(), info.index.end(), splitter,
+                                      [](const RunIndexEntry& lhs, uint64_t key) { return lhs.key < key; });
+        if (entry == info.index.begin()) {
+            position = RunPosition();
+            return true;
         }
+        position = std::prev(entry)->position;
         
-        // Устойчивая сортировка по ключу
-        std::stable_sort(batch.begin(), batch.end(), 
-                         [](const KeyValuePair& a, const KeyValuePair& b) {
-                             return a.key < b.key;
-                         });
-        
-        // Запись отсортированного пакета во временный файл
-        const std::string tempFile = createTempFile(batchIndex);
-        std::ofstream output(tempFile);
-        if (!output) {
-            std::cerr << "Ошибка: не удалось создать временный файл " << tempFile << std::endl;
+        RunReader file({&info.path, position.offset, info.end.offset, position.previousKey},
+                       options.spillFormat, MIN_IO_BLOCK, nullptr);
+        if (!file) {
+            std::cerr << "Ошибка: не удалось открыть временный файл " + info.path + "\n";
             return false;
         }
-        
-        for (const auto& pair : batch) {
-            output << pair.key << ":" << pair.value << "\n";
+        KeyValuePair pair;
+        ReadStatus status;
+        while ((status = file.next(pair)) == ReadStatus::Ok && pair.key < splitter) {
+            position.offset += file.lastSize();
+            position.textOffset += textSize(pair.key, pair.value);
+            position.previousKey = pair.key;
+        }
+        if (status == ReadStatus::Corrupted || file.failed()) {
+            std::cerr << "Ошибка: поврежден временный файл " + info.path + "\n";
+            return false;
         }
-        
-        linesProcessed += lineIndex;
         return true;
     }
     
-    // Объединяет все временные файлы в итоговый
-    bool mergeTempFiles(size_t tempFileCount) {
-        if (tempFileCount == 0) {
+    // Последний проход, разбитый по диапазонам ключей. Каждый поток сливает свои
+    // диапазоны всех временных файлов и пишет текст в собственную область файла
+    // результата: ее начало - суммарный объем текста всех записей с меньшими ключами.
+    // Равные ключи всегда попадают в один диапазон, поэтому устойчивость сохраняется
+    bool mergePartitioned(const std::vector<RunInfo>& infos, const std::vector<uint64_t>& splitters) {
+        const size_t parts = splitters.size() + 1;
+        
+        // bounds[k][run] - граница между диапазонами k и k + 1 в файле run
+        std::vector<std::vector<RunPosition>> bounds(parts + 1, std::vector<RunPosition>(infos.size()));
+        for (size_t run = 0; run < infos.size(); ++run) {
+            bounds[parts][run] = infos[run].end;
+        }
+        std::atomic<bool> failed(false);
+        std::vector<std::thread> threads;
+        for (size_t k = 0; k < splitters.size(); ++k) {
+            threads.emplace_back([this, &infos, &splitters, &bounds, &failed, k] {
+                for (size_t run = 0; run < infos.size() && !failed; ++run) {
+                    if (!findBoundary(infos[run], splitters[k], bounds[k + 1][run])) {
+                        failed = true;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (failed) {
             return false;
         }
         
-        // Если только один временный файл, просто переименовываем его
-        if (tempFileCount == 1) {
-            std::string tempFile = createTempFile(0);
-            std::ifstream input(tempFile, std::ios::binary);
-            std::ofstream output(outputPath, std::ios::binary);
-            
-            if (!input || !output) {
-                std::cerr << "Ошибка при переименовании единственного временного файла" << std::endl;
+        // Создаем файл результата; потоки дописывают его в своих областях
+        {
+            std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+            if (!output) {
+                std::cerr << "Ошибка: не удалось создать файл результата " << outputPath << std::endl;
                 return false;
             }
-            
-            output << input.rdbuf();
-            input.close();
-            output.close();
-            std::remove(tempFile.c_str());
-            return true;
         }
         
-        // Структура для многопутевого слияния
-        struct FileEntry {
-            std::ifstream file;
-            KeyValuePair currentPair;
-            bool hasNext;
-            
-            FileEntry(const std::string& path) : file(path), hasNext(false) {
-                readNext();
-            }
-            
-            void readNext() {
-                std::string line;
-                if (std::getline(file, line)) {
-                    if (parseKeyValue(line, currentPair)) {
-                        hasNext = true;
-                    } else {
-                        readNext(); // Пропускаем некорректные строки
+        const size_t blockSize = mergeBlockSize(infos.size(), parts);
+        std::cout << "Параллельное слияние: диапазонов " << parts << ", блок чтения "
+                  << blockSize / 1024 << " КиБ" << std::endl;
+        
+        threads.clear();
+        for (size_t part = 0; part < parts; ++part) {
+            threads.emplace_back([this, &infos, &bounds, &failed, part, parts, blockSize] {
+                std::vector<RunRange> ranges;
+                uint64_t textOffset = 0;
+                for (size_t run = 0; run < infos.size(); ++run) {
+                    const RunPosition& begin = bounds[part][run];
+                    const RunPosition& end = bounds[part + 1][run];
+                    textOffset += begin.textOffset;
+                    if (begin.offset != end.offset) {
+                        ranges.push_back({&infos[run].path, begin.offset, end.offset, begin.previousKey});
+                    }
+                }
+                if (ranges.empty()) {
+                    return;
+                }
+                
+                BlockWriter output(outputPath, BlockWriter::At{textOffset}, blockSize, io.get());
+                if (!output) {
+                    std::cerr << "Ошибка: не удалось открыть файл результата " + outputPath + "\n";
+                    failed = true;
+                    return;
+                }
+                const bool merged = mergeToOutput(ranges, blockSize, output, gatherMemory() / parts);
+                if (!output.close() || !merged) {
+                    if (merged) {
+                        std::cerr << "Ошибка: не удалось записать файл результата " + outputPath + "\n";
                     }
-                } else {
-                    hasNext = false;
+                    failed = true;
                 }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return !failed;
+    }
+    
+    // Проверяет, не перекрываются ли диапазоны ключей непустых временных файлов, и
+    // возвращает в order номера файлов по возрастанию ключей. Так бывает, когда
+    // вход упорядочен по возрастанию или убыванию. Равный ключ на границе допустим,
+    // только если его содержит сначала более ранний файл, иначе нарушится устойчивость
+    static bool disjointRuns(const std::vector<RunInfo>& infos, std::vector<size_t>& order) {
+        order.clear();
+        for (size_t i = 0; i < infos.size(); ++i) {
+            if (infos[i].records != 0) {
+                order.push_back(i);
             }
-        };
-        
-        // Открываем все временные файлы
-        std::vector<FileEntry> files;
-        files.reserve(tempFileCount);
-        
-        for (size_t i = 0; i < tempFileCount; ++i) {
-            files.emplace_back(createTempFile(i));
-            if (!files.back().file) {
-                std::cerr << "Ошибка: не удалось открыть временный файл " << createTempFile(i) << std::endl;
+        }
+        std::sort(order.begin(), order.end(), [&infos](size_t a, size_t b) {
+            const uint64_t lhs = infos[a].index.front().key;
+            const uint64_t rhs = infos[b].index.front().key;
+            return lhs != rhs ? lhs < rhs : a < b;
+        });
+        for (size_t i = 1; i < order.size(); ++i) {
+            const RunInfo& previous = infos[order[i - 1]];
+            const RunInfo& next = infos[order[i]];
+            if (previous.lastKey > next.index.front().key ||
+                (previous.lastKey == next.index.front().key && order[i - 1] > order[i])) {
                 return false;
             }
         }
+        return true;
+    }
+    
+    // Последовательно копирует временные файлы в порядке order в файл результата
+    bool concatenateRuns(const std::vector<size_t>& order) {
+        std::cout << "Временные файлы не перекрываются по ключам: слияние заменено последовательным копированием"
+                  << std::endl;
+        statistics.mergePasses = 1;
+        statistics.fanIn = 1;
+        statistics.partitions = 1;
         
-        // Открываем выходной файл
-        std::ofstream output(outputPath);
+        const Clock::time_point finalStart = Clock::now();
+        const size_t blockSize = mergeBlockSize(1);
+        BlockWriter output(outputPath, blockSize, io.get());
         if (!output) {
             std::cerr << "Ошибка: не удалось создать файл результата " << outputPath << std::endl;
             return false;
         }
+        const std::vector<RunRange> ranges = wholeRuns(runs);
+        for (const size_t run : order) {
+            if (!mergeToOutput({ranges[run]}, blockSize, output, gatherMemory())) {
+                return false;
+            }
+        }
+        if (!output.close()) {
+            std::cerr << "Ошибка: не удалось записать файл результата " << outputPath << std::endl;
+            return false;
+        }
+        releaseRuns();
+        statistics.finalMergeNanos = elapsedNanos(finalStart);
+        return true;
+    }
+    
+    // Объединяет все временные файлы в итоговый, при необходимости в несколько проходов
+    bool mergeTempFiles() {
+        if (runs.empty()) {
+            return false;
+        }
+        std::vector<size_t> order;
+        if (disjointRuns(runs, order)) {
+            return concatenateRuns(order);
+        }
+        size_t nextTempIndex = runs.size();
         
-        // Выполняем многопутевое слияние
-        while (true) {
-            // Находим файл с минимальным следующим ключом
-            size_t minIndex = 0;
-            bool foundValid = false;
-            
-            for (size_t i = 0; i < files.size(); ++i) {
-                if (files[i].hasNext) {
-                    if (!foundValid || 
-                        (files[i].currentPair.key < files[minIndex].currentPair.key) ||
-                        (files[i].currentPair.key == files[minIndex].currentPair.key && 
-                         files[i].currentPair.originalIndex < files[minIndex].currentPair.originalIndex)) {
-                        minIndex = i;
-                        foundValid = true;
+        const MergePlan plan = planMerge(runs.size());
+        std::cout << "План слияния: временных файлов " << plan.runs << ", проходов " << plan.passes
+                  << ", файлов в слиянии до " << plan.fanIn << ", блок чтения "
+                  << plan.blockSize / 1024 << " КиБ" << std::endl;
+        statistics.mergePasses = plan.passes;
+        statistics.fanIn = plan.fanIn;
+        statistics.partitions = 1;
+        const Clock::time_point mergeStart = Clock::now();
+        
+        // Промежуточные проходы: соседние файлы сливаются группами в новые временные
+        // файлы, поэтому порядок файлов, а с ним и устойчивость, сохраняются
+        for (size_t pass = 1; pass < plan.passes; ++pass) {
+            const size_t groupCount = (runs.size() + plan.fanIn - 1) / plan.fanIn;
+            std::vector<RunInfo> mergedRuns;
+            size_t first = 0;
+            for (size_t group = 0; group < groupCount; ++group) {
+                const size_t groupSize = runs.size() / groupCount + (group < runs.size() % groupCount ? 1 : 0);
+                const std::vector<RunInfo> inputs(std::make_move_iterator(runs.begin() + first),
+                                                  std::make_move_iterator(runs.begin() + first + groupSize));
+                first += groupSize;
+                
+                const std::string mergedRun = createTempFile(nextTempIndex++);
+                RunWriter output(mergedRun, options.spillFormat, plan.blockSize, io.get(), manifestEnabled());
+                if (!output) {
+                    std::cerr << "Ошибка: не удалось создать временный файл " << mergedRun << std::endl;
+                    return false;
+                }
+                const bool merged = mergeRuns(wholeRuns(inputs), plan.blockSize, [this, &output](uint64_t key, std::string_view value) {
+                    output.write(key, value, textSize(key, value));
+                });
+                if (!merged) {
+                    return false;
+                }
+                if (!output.close()) {
+                    std::cerr << "Ошибка: не удалось записать временный файл " << mergedRun << std::endl;
+                    return false;
+                }
+                statistics.spilledBytes += output.result().end.offset;
+                output.result().inputEnd = inputs.back().inputEnd;
+                output.result().inputSample = inputs.back().inputSample;
+                mergedRuns.push_back(std::move(output.result()));
+                
+                // Манифест сначала перечисляет слитый файл вместо исходных и только
+                // затем исходные удаляются: прерванный проход продолжается с той же группы
+                if (manifestEnabled()) {
+                    std::vector<const RunInfo*> list;
+                    for (const auto& info : mergedRuns) {
+                        list.push_back(&info);
+                    }
+                    for (size_t i = first; i < runs.size(); ++i) {
+                        list.push_back(&runs[i]);
+                    }
+                    std::lock_guard<std::mutex> lock(runsMutex);
+                    if (!writeManifest(list)) {
+                        return false;
                     }
                 }
+                removeFiles(inputs);
             }
-            
-            if (!foundValid) {
-                break; // Все файлы обработаны
+            runs.swap(mergedRuns);
+        }
+        statistics.mergeNanos = elapsedNanos(mergeStart);
+        
+        const Clock::time_point finalStart = Clock::now();
+        
+        // Последний проход записывает результат в текстовом виде; при нескольких
+        // потоках он разбивается на независимые диапазоны ключей
+        const std::vector<uint64_t> splitters = chooseSplitters(runs, partitionCount(runs));
+        if (!splitters.empty()) {
+            statistics.partitions = splitters.size() + 1;
+            if (!mergePartitioned(runs, splitters)) {
+                return false;
             }
-            
-            // Записываем минимальную пару в выходной файл
-            output << files[minIndex].currentPair.key << ":" << files[minIndex].currentPair.value << "\n";
-            
-            // Читаем следующую запись из этого файла
-            files[minIndex].readNext();
+            releaseRuns();
+            statistics.finalMergeNanos = elapsedNanos(finalStart);
+            return true;
         }
         
-        // Закрываем все файлы и удаляем временные
-        output.close();
-        for (size_t i = 0; i < tempFileCount; ++i) {
-            std::string tempFile = createTempFile(i);
-            files[i].file.close();
-            std::remove(tempFile.c_str());
+        BlockWriter output(outputPath, plan.blockSize, io.get());
+        if (!output) {
+            std::cerr << "Ошибка: не удалось создать файл результата " << outputPath << std::endl;
+            return false;
+        }
+        const bool merged = mergeToOutput(wholeRuns(runs), plan.blockSize, output, gatherMemory());
+        if (!merged) {
+            return false;
+        }
+        if (!output.close()) {
+            std::cerr << "Ошибка: не удалось записать файл результата " << outputPath << std::endl;
+            return false;
         }
+        releaseRuns();
+        statistics.finalMergeNanos = elapsedNanos(finalStart);
         
         return true;
     }
-
-public:
-    FileSorter(const std::string& input, const std::string& output)
-        : inputPath(input), outputPath(output) {}
-
-    bool sort() {
-        std::ifstream input(inputPath);
-        if (!input) {
+    
+    // Формирует пакеты и сливает временные файлы
+    bool sortFile() {
+        const Clock::time_point start = Clock::now();
+        if (!checkTempDirs()) {
+            return false;
+        }
+        if (options.asyncIo) {
+            io = std::make_unique<IoExecutor>(IO_THREADS);
+        }
+        keysOnly = chooseKeysOnly();
+        statistics.strategy = keysOnly ? "keys" : "records";
+        if (keysOnly) {
+            std::cout << "Стратегия сортировки: keys (значения читаются из входного файла при выводе)" << std::endl;
+        }
+        
+        // Выбор с заменой однопоточен: куча занимает почти весь лимит памяти
+        const bool replacement = options.runFormation == RunFormation::Replacement;
+        statistics.runFormation = replacement ? "replacement" : "batches";
+        
+        // Если лимит памяти не позволяет держать пакет для каждого потока,
+        // число потоков уменьшается
+        size_t threadCount = replacement ? 1 : workerCount();
+        size_t memoryBudget = batchMemoryBudget(threadCount);
+        while (memoryBudget == 0 && threadCount > 1) {
+            memoryBudget = batchMemoryBudget(--threadCount);
+        }
+        if (memoryBudget == 0) {
+            std::cerr << "Ошибка: лимит памяти " << options.memoryLimit << " байт слишком мал" << std::endl;
+            return false;
+        }
+        batchBudget = memoryBudget;
+        
+        // Готовые временные файлы из манифеста не формируются заново: чтение входного
+        // файла продолжается с границы последнего из них. Если файл с тех пор только
+        // дополнялся, новые строки образуют новые временные файлы
+        uint64_t resumeOffset = 0;
+        if (manifestEnabled() && !loadManifest(resumeOffset)) {
+            return false;
+        }
+        
+        const size_t blockSize = ioBlockSize(threadCount + 1);
+        InputCursor input(inputPath, blockSize, io.get(), resumeOffset);
+        if (!input.file) {
             std::cerr << "Ошибка: не удалось открыть входной файл " << inputPath << std::endl;
             return false;
         }
         
-        size_t tempFileCount = 0;
-        size_t linesProcessed = 0;
+        size_t tempFileCount = runs.size();
+        bool inMemory = false;
+        std::atomic<bool> failed(false);
+        
+        // Если по размеру входной файл помещается в память, первый пакет читается
+        // с бюджетом всего лимита и при достижении конца файла сортируется без
+        // временных файлов. Иначе этот крупный пакет сбрасывается во временный файл
+        // до запуска конвейера, поэтому лимит не превышается
+        std::error_code sizeError;
+        const uintmax_t inputSize = std::filesystem::file_size(inputPath, sizeError);
+        const size_t wholeBudget = usableMemory() - ioMemory(threadCount + 1);
+        if (!keysOnly && tempFileCount == 0 && !sizeError && inputSize < wholeBudget && wholeBudget > memoryBudget) {
+            RawBatch batch;
+            if (readBatch(input, batch, wholeBudget)) {
+                batch.inputEnd = input.offset;
+                batch.index = tempFileCount++;
+                batch.complete = inMemory = input.exhausted();
+                failed = !sortBatch(batch, blockSize);
+            }
+        }
         
-        // Обрабатываем файл по частям
-        while (sortBatch(input, tempFileCount, linesProcessed)) {
-            tempFileCount++;
+        if (replacement) {
+            // Первый пакет, если он не уместил весь файл, уже записан во временный
+            // файл; остальные строки распределяются по файлам выбором с заменой
+            if (!failed && !inMemory) {
+                failed = !selectRuns(input, tempFileCount, wholeBudget, blockSize);
+            }
+        } else {
+            // Конвейер: текущий поток читает пакеты, пул потоков сортирует их
+            // и записывает каждый в собственный временный файл
+            BoundedQueue<RawBatch> queue(1);
+            std::vector<std::thread> workers;
+            workers.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i) {
+                workers.emplace_back([this, &queue, &failed, blockSize] {
+                    RawBatch batch;
+                    while (queue.pop(batch)) {
+                        // После ошибки пакеты только извлекаются, чтобы не блокировать чтение
+                        if (!failed && !sortBatch(batch, blockSize)) {
+                            failed = true;
+                        }
+                    }
+                });
+            }
+            
+            // Обрабатываем файл по частям
+            RawBatch batch;
+            auto readNext = [&] {
+                return keysOnly ? readLocators(input, batch, memoryBudget) : readBatch(input, batch, memoryBudget);
+            };
+            while (!failed && !inMemory && readNext()) {
+                batch.inputEnd = input.offset;
+                batch.index = tempFileCount++;
+                // Первый пакет, дочитавший файл до конца, записывается сразу в результат
+                batch.complete = inMemory = batch.index == 0 && input.exhausted();
+                queue.push(std::move(batch));
+                batch = RawBatch();
+            }
+            
+            queue.close();
+            for (auto& worker : workers) {
+                worker.join();
+            }
         }
+        statistics.runFormationNanos = elapsedNanos(start);
+        statistics.inMemory = inMemory;
+        statistics.runs = inMemory ? 0 : tempFileCount;
         
-        input.close();
+        if (input.file.failed()) {
+            std::cerr << "Ошибка: не удалось прочитать входной файл " << inputPath << std::endl;
+            return false;
+        }
+        if (failed) {
+            return false;
+        }
+        if (inMemory) {
+            std::cout << "Входной файл отсортирован в памяти, временные файлы не создавались" << std::endl;
+            return true;
+        }
         
         // Если не было создано временных файлов, значит входной файл пуст
         if (tempFileCount == 0) {
@@ -241,25 +3032,237 @@ public:
         }
         
         // Объединяем временные файлы
-        return mergeTempFiles(tempFileCount);
+        return mergeTempFiles();
+    }
+
+public:
+    FileSorter(const std::string& input, const std::string& output, const SortOptions& options = SortOptions())
+        : inputPath(input), outputPath(output), options(options), tempPrefix(tempFilePrefix()) {}
+
+    bool sort() {
+        const Clock::time_point start = Clock::now();
+        const bool sorted = sortFile();
+        
+        // Все ошибки сортировки и слияния приводят сюда; созданные к этому моменту
+        // временные файлы закрыты и удаляются, чтобы не оставаться на диске.
+        // Перечисленные в манифесте остаются для возобновления сортировки
+        if (!sorted) {
+            removeTempFiles();
+            if (!manifestRuns.empty()) {
+                std::cerr << "Временные файлы из манифеста " << options.manifestPath
+                          << " сохранены: повторный запуск продолжит сортировку" << std::endl;
+            }
+        } else if (manifestEnabled() && !options.keepRuns) {
+            std::error_code error;
+            std::filesystem::remove(options.manifestPath, error);
+        }
+        statistics.totalNanos = elapsedNanos(start);
+        if (sorted) {
+            std::error_code error;
+            const uintmax_t size = std::filesystem::file_size(outputPath, error);
+            statistics.outputBytes = error ? 0 : size;
+        }
+        return sorted;
+    }
+    
+    // Статистика выполнения последней сортировки
+    const SortStats& stats() const {
+        return statistics;
     }
 };
 
+// Выводит справку по использованию программы
+void printUsage(const char* programName) {
+    std::cerr << "Использование: " << programName << " [опции] <входной_файл> <выходной_файл>" << std::endl;
+    std::cerr << "Опции:" << std::endl;
+    std::cerr << "  --threads=N        число потоков сортировки пакетов (по умолчанию - по числу ядер)" << std::endl;
+    std::cerr << "  --memory-limit=N   лимит оперативной памяти, допускаются суффиксы K, M, G, T" << std::endl;
+    std::cerr << "                     (например, --memory-limit=2G; по умолчанию 1G)" << std::endl;
+    std::cerr << "  --sort-engine=E    сортировка пакетов: radix (по умолчанию) или stable" << std::endl;
+    std::cerr << "  --async-io         упреждающее чтение и фоновая запись файлов" << std::endl;
+    std::cerr << "  --fan-in=N         наибольшее число файлов в одном слиянии (не меньше 2)" << std::endl;
+    std::cerr << "  --spill-format=F   формат временных файлов: plain (по умолчанию) или compact" << std::endl;
+    std::cerr << "                     (разности ключей и упаковка буквенно-цифровых значений)" << std::endl;
+    std::cerr << "  --stats[=F]        статистика этапов: text (по умолчанию) в стандартный вывод" << std::endl;
+    std::cerr << "                     или json в стандартный поток ошибок" << std::endl;
+    std::cerr << "  --strategy=S       стратегия: auto (по умолчанию; по средней длине строки), records" << std::endl;
+    std::cerr << "                     или keys (сортируются ключи, значения читаются при выводе)" << std::endl;
+    std::cerr << "  --run-formation=R  временные файлы: batches (по умолчанию; пакеты сортируются параллельно)" << std::endl;
+    std::cerr << "                     или replacement (выбор с заменой: файлы вдвое длиннее, один поток)" << std::endl;
+    std::cerr << "  --tmp-dir=D[,D]    каталоги временных файлов (по умолчанию - рядом с результатом);" << std::endl;
+    std::cerr << "                     файлы распределяются по нескольким каталогам по кругу и называются" << std::endl;
+    std::cerr << "                     по имени результата и хешу его полного пути" << std::endl;
+    std::cerr << "  --manifest=FILE    вести манифест готовых временных файлов: прерванная сортировка" << std::endl;
+    std::cerr << "                     при повторном запуске продолжается без их повторного формирования" << std::endl;
+    std::cerr << "  --keep-runs        сохранить временные файлы и манифест после сортировки: после" << std::endl;
+    std::cerr << "                     дополнения входного файла сортируются только новые строки" << std::endl;
+}
+
+// Разбирает числовое значение опции
+bool parseCount(const std::string& text, size_t& value) {
+    const char* start = text.data();
+    const char* end = start + text.size();
+    auto result = std::from_chars(start, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// Разбирает объем памяти с необязательным двоичным суффиксом K, M, G или T
+bool parseMemorySize(const std::string& text, size_t& value) {
+    const char* start = text.data();
+    const char* end = start + text.size();
+    auto result = std::from_chars(start, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    if (result.ptr == end) {
+        return true;
+    }
+    if (result.ptr + 1 != end) {
+        return false;
+    }
+    
+    unsigned shift = 0;
+    switch (*result.ptr) {
+        case 'K': case 'k': shift = 10; break;
+        case 'M': case 'm': shift = 20; break;
+        case 'G': case 'g': shift = 30; break;
+        case 'T': case 't': shift = 40; break;
+        default: return false;
+    }
+    if (value > (SIZE_MAX >> shift)) {
+        return false;
+    }
+    value <<= shift;
+    return true;
+}
+
+// Разбирает опцию командной строки вида --имя=значение
+bool parseOption(const std::string& arg, SortOptions& options) {
+    const size_t eqPos = arg.find('=');
+    const std::string name = arg.substr(0, eqPos);
+    const std::string value = eqPos == std::string::npos ? std::string() : arg.substr(eqPos + 1);
+    
+    if (name == "--threads") {
+        return parseCount(value, options.threads) && options.threads > 0;
+    }
+    if (name == "--memory-limit") {
+        return parseMemorySize(value, options.memoryLimit) && options.memoryLimit > 0;
+    }
+    if (name == "--fan-in") {
+        return parseCount(value, options.fanIn) && options.fanIn >= 2;
+    }
+    if (name == "--async-io") {
+        options.asyncIo = true;
+        return eqPos == std::string::npos;
+    }
+    if (name == "--stats") {
+        if (eqPos == std::string::npos || value == "text") {
+            options.stats = StatsFormat::Text;
+        } else if (value == "json") {
+            options.stats = StatsFormat::Json;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (name == "--strategy") {
+        if (value == "auto") {
+            options.strategy = SortStrategy::Auto;
+        } else if (value == "records") {
+            options.strategy = SortStrategy::Records;
+        } else if (value == "keys") {
+            options.strategy = SortStrategy::Keys;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (name == "--run-formation") {
+        if (value == "batches") {
+            options.runFormation = RunFormation::Batches;
+        } else if (value == "replacement") {
+            options.runFormation = RunFormation::Replacement;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (name == "--tmp-dir") {
+        // Каталоги перечисляются через запятую; повторная опция добавляет каталоги
+        size_t start = 0;
+        while (start <= value.size()) {
+            const size_t comma = std::min(value.find(',', start), value.size());
+            if (comma == start) {
+                return false;
+            }
+            options.tempDirs.push_back(value.substr(start, comma - start));
+            start = comma + 1;
+        }
+        return true;
+    }
+    if (name == "--manifest") {
+        options.manifestPath = value;
+        return !value.empty();
+    }
+    if (name == "--keep-runs") {
+        options.keepRuns = true;
+        return eqPos == std::string::npos;
+    }
+    if (name == "--spill-format") {
+        if (value == "plain") {
+            options.spillFormat = SpillFormat::Plain;
+        } else if (value == "compact") {
+            options.spillFormat = SpillFormat::Compact;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    if (name == "--sort-engine") {
+        if (value == "radix") {
+            options.engine = SortEngine::Radix;
+        } else if (value == "stable") {
+            options.engine = SortEngine::Stable;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
 int main(int argc, char* argv[]) {
-    // Проверка аргументов командной строки
-    if (argc != 3) {
-        std::cerr << "Использование: " << argv[0] << " <входной_файл> <выходной_файл>" << std::endl;
+    // Разбор аргументов командной строки: два позиционных параметра и опции вида --имя=значение
+    std::vector<std::string> positional;
+    SortOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+        } else if (!parseOption(arg, options)) {
+            std::cerr << "Ошибка: некорректная опция " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (positional.size() != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.keepRuns && options.manifestPath.empty()) {
+        std::cerr << "Ошибка: опция --keep-runs требует --manifest" << std::endl;
         return 1;
     }
 
-    std::string inputPath = argv[1];
-    std::string outputPath = argv[2];
+    std::string inputPath = positional[0];
+    std::string outputPath = positional[1];
 
     // Запускаем таймер
     auto startTime = std::chrono::high_resolution_clock::now();
     
     // Создаем и запускаем сортировщик
-    FileSorter sorter(inputPath, outputPath);
+    FileSorter sorter(inputPath, outputPath, options);
     if (!sorter.sort()) {
         std::cerr << "Ошибка при сортировке файла" << std::endl;
         return 1;
@@ -272,5 +3275,11 @@ int main(int argc, char* argv[]) {
     std::cout << "Сортировка завершена успешно. Результат сохранен в " << outputPath << std::endl;
     std::cout << "Время выполнения: " << duration.count() << " мс" << std::endl;
     
+    if (options.stats == StatsFormat::Text) {
+        std::cout << formatStats(sorter.stats()) << std::flush;
+    } else if (options.stats == StatsFormat::Json) {
+        std::cerr << formatStatsJson(sorter.stats()) << std::flush;
+    }
+    
     return 0;
 }